@@ -4,8 +4,6 @@
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
 
-#include <omp.h>
-
 #include "klein/klein.hpp"
 
 
@@ -25,7 +23,7 @@ void initEditor(GLFWwindow* window)
 }
 
 
-void drawEditor(RayMarchingManager& rayMarching)
+void drawEditor(RayMarchingManager& rayMarching, const Framebuffer& fbo)
 {
     //New Frame
     ImGuiIO& io = ImGui::GetIO();
@@ -95,8 +93,9 @@ void drawEditor(RayMarchingManager& rayMarching)
     if (ImGui::Begin("Settings"))
     {
         ImGui::Text("Fps %.1f", ImGui::GetIO().Framerate);
-        ImGui::Text("Samples : %d / 20", rayMarching.getCurrentSample());
-        ImGui::Text("Threads: %d", omp_get_max_threads());
+        ImGui::Text("Samples : %d / %d", rayMarching.getCurrentSample(), rayMarching.getMaxSamples());
+        ImGui::Text("Threads: %d", rayMarching.getThreadCount());
+        ImGui::Text("Resolution: %d x %d", rayMarching.getRenderWidth(), rayMarching.getRenderHeight());
 
         ImGui::Separator();
 
@@ -112,10 +111,94 @@ void drawEditor(RayMarchingManager& rayMarching)
                 rayMarching.UpdateScene();
             }
 
+            int maxSamples = rayMarching.getMaxSamples();
+            if (ImGui::SliderInt("Max Samples", &maxSamples, 1, 64))
+            {
+                rayMarching.setMaxSamples(maxSamples);
+            }
+
+            if (ImGui::Checkbox("Dynamic Resolution", &rayMarching.getDynamicResolution()))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (rayMarching.getDynamicResolution())
+            {
+                ImGui::DragFloat("Frame Budget (ms)", &rayMarching.getFrameBudget(), 1.0f, 5.0f, 200.0f);
+                ImGui::DragFloat("Min Scale", &rayMarching.getMinRenderScale(), 0.01f, 0.1f, 1.0f);
+            }
+
+            if (ImGui::Checkbox("Checkerboard", &rayMarching.getCheckerboard()))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (ImGui::Checkbox("Adaptive Sampling", &rayMarching.getAdaptiveSampling()))
+            {
+                rayMarching.UpdateSampling();
+            }
+
+            if (rayMarching.getAdaptiveSampling()
+                && ImGui::DragFloat("Noise Threshold", &rayMarching.getAdaptiveThreshold(), 0.05f, 0.05f, 10.0f))
+            {
+                rayMarching.UpdateSampling();
+            }
+
             if (ImGui::Checkbox("UsePGA", &rayMarching.getUsePGA()))
             {
                 rayMarching.UpdateScene();
             }
+
+            if (ImGui::Checkbox("Ray Packets", &rayMarching.getUsePackets()))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (ImGui::Checkbox("BVH", &rayMarching.getUseBVH()))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (ImGui::Checkbox("Over-relaxation", &rayMarching.getOverRelaxation()))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (rayMarching.getOverRelaxation()
+                && ImGui::DragFloat("Relaxation", &rayMarching.getRelaxationFactor(), 0.01f, 1.0f, 2.0f))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (ImGui::Checkbox("Cone Marching", &rayMarching.getConeMarching()))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (ImGui::Checkbox("Analytic Spheres", &rayMarching.getAnalyticSpheres()))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (ImGui::Checkbox("Tile Binning", &rayMarching.getTileBinning()))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (ImGui::Checkbox("Reprojection", &rayMarching.getReprojection()))
+            {
+                rayMarching.UpdateScene();
+            }
+
+            if (rayMarching.getReprojection())
+            {
+                ImGui::DragFloat("Reprojection Margin", &rayMarching.getReprojectionMargin(), 0.005f, 0.0f, 1.0f);
+            }
+
+            if (ImGui::Combo("Normals", &(int&)rayMarching.getNormalMode(), "Central Differences\0Tetrahedron\0Analytic\0\0"))
+            {
+                rayMarching.UpdateScene();
+            }
         }
 
         if (ImGui::CollapsingHeader("Camera"))
@@ -127,6 +210,22 @@ void drawEditor(RayMarchingManager& rayMarching)
             }
         }
 
+        if (ImGui::CollapsingHeader("Lighting"))
+        {
+            // The G-buffer only holds the first sample of each pixel
+            ImGui::TextWrapped("A light change reshades the first sample without marching, the other samples are marched again");
+
+            if (ImGui::DragFloat3("Light", &rayMarching.getLight()[0], 0.01f, -10.0f, 10.0f))
+            {
+                rayMarching.UpdateLighting();
+            }
+
+            if (ImGui::Checkbox("Point Light", &rayMarching.getPositionLight()))
+            {
+                rayMarching.UpdateLighting();
+            }
+        }
+
         if (ImGui::CollapsingHeader("World Outliner", ImGuiTreeNodeFlags_DefaultOpen))
         {
             int shapesCount = 0;
@@ -157,13 +256,13 @@ void drawEditor(RayMarchingManager& rayMarching)
                         rayMarching.getShapeAtIndex(selectedEntityID).position.z
                     };
 
-                    rayMarching.UpdateScene();
+                    rayMarching.UpdateShape(selectedEntityID);
                 }
                 if (ImGui::DragFloat("Scale", &rayMarching.getShapeAtIndex(selectedEntityID).size[0], 0.1f, 0.1f, 10.0f))
                 {
                     rayMarching.getShapeAtIndex(selectedEntityID).size[1] = rayMarching.getShapeAtIndex(selectedEntityID).size[0];
                     rayMarching.getShapeAtIndex(selectedEntityID).size[2] = rayMarching.getShapeAtIndex(selectedEntityID).size[0];
-                    rayMarching.UpdateScene();
+                    rayMarching.UpdateShape(selectedEntityID);
                 }
 
                 if (ImGui::TreeNodeEx("Operation Settings", ImGuiTreeNodeFlags_DefaultOpen))
@@ -191,8 +290,12 @@ void drawEditor(RayMarchingManager& rayMarching)
                             {
                                 shape.blendStrength = rayMarching.getShapeAtIndex(selectedEntityID).blendStrength;
                             }
+                            rayMarching.UpdateScene();
+                        }
+                        else
+                        {
+                            rayMarching.UpdateShape(selectedEntityID);
                         }
-                        rayMarching.UpdateScene();
                     }
 
                     ImGui::TreePop();
@@ -210,7 +313,7 @@ void drawEditor(RayMarchingManager& rayMarching)
         //ImVec2 wsize = ImGui::GetContentRegionAvail();
         ImVec2 wsize = { 600, 480 };
 
-        ImGui::Image((ImTextureID)rayMarching.getFbo().getTextureId(), wsize, ImVec2(0, 1), ImVec2(1, 0));
+        ImGui::Image((ImTextureID)fbo.getTextureId(), wsize, ImVec2(0, 1), ImVec2(1, 0));
     }
     ImGui::End();
 
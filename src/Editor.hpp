@@ -3,10 +3,11 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "Framebuffer.hpp"
 #include "RayMarching.hpp"
 
 void initEditor(GLFWwindow* window);
 
-void drawEditor(RayMarchingManager& rayMarching);
+void drawEditor(RayMarchingManager& rayMarching, const Framebuffer& fbo);
 
 void renderEditor();
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "Framebuffer.hpp"
 
 #include <glad/glad.h>
+#include <algorithm>
 #include <iostream>
 #include "glm/glm.hpp"
 #include "glm/gtx/transform.hpp"
@@ -16,7 +17,7 @@ Framebuffer::Framebuffer(float width, float height, const std::vector<unsigned c
         // Create Texture
         glGenTextures(1, &_textureID);
         glBindTexture(GL_TEXTURE_2D, _textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, buffer.data());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, buffer.data());
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
@@ -32,14 +33,65 @@ Framebuffer::Framebuffer(float width, float height, const std::vector<unsigned c
             std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    createPixelBuffers();
+}
+
+void Framebuffer::createPixelBuffers()
+{
+    if (!GLAD_GL_VERSION_4_4)
+    {
+        return;
+    }
+
+    const GLsizeiptr size = (GLsizeiptr)_width * _height * 4;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(PIXEL_BUFFER_COUNT, _pixelBuffers);
+    for (int i = 0; i < PIXEL_BUFFER_COUNT; ++i)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pixelBuffers[i]);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+        _pixelBufferData[i] = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void Framebuffer::freePixelBuffers()
+{
+    for (int i = 0; i < PIXEL_BUFFER_COUNT; ++i)
+    {
+        if (_fences[i])
+        {
+            glDeleteSync(_fences[i]);
+            _fences[i] = nullptr;
+        }
+
+        if (_pixelBufferData[i])
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pixelBuffers[i]);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            _pixelBufferData[i] = nullptr;
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (_pixelBuffers[0])
+    {
+        glDeleteBuffers(PIXEL_BUFFER_COUNT, _pixelBuffers);
+        std::fill(_pixelBuffers, _pixelBuffers + PIXEL_BUFFER_COUNT, 0u);
+    }
+    _nextPixelBuffer = 0;
 }
 
 void Framebuffer::resize(float width, float height)
 {
+    _width = width;
+    _height = height;
+
     glBindFramebuffer(GL_FRAMEBUFFER, _id);
     {
         glBindTexture(GL_TEXTURE_2D, _textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
         glBindTexture(GL_TEXTURE_2D, 0);
 
         glBindRenderbuffer(GL_RENDERBUFFER, _rboID);
@@ -47,6 +99,10 @@ void Framebuffer::resize(float width, float height)
         glBindRenderbuffer(GL_RENDERBUFFER, 0);
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // The pixel buffers hold a frame of the previous size
+    freePixelBuffers();
+    createPixelBuffers();
 }
 
 void Framebuffer::bind(float viewportWidth, float viewportHeight)
@@ -65,17 +121,71 @@ void Framebuffer::unbind()
 
 void Framebuffer::free()
 {
+    freePixelBuffers();
+
     glDeleteFramebuffers(1, &_id);
     glDeleteTextures(1, &_textureID);
     glDeleteRenderbuffers(1, &_rboID);
 }
 
 
+void Framebuffer::present(const std::vector<unsigned char>& buffer, int width, int height)
+{
+    if (width != _width || height != _height)
+    {
+        resize((float)width, (float)height);
+    }
+
+    if (buffer.size() != (size_t)_width * _height * 3)
+    {
+        std::cout << "ERROR::FRAMEBUFFER:: Frame of " << buffer.size() << " bytes for a "
+            << _width << "x" << _height << " texture" << std::endl;
+        return;
+    }
+
+    update(buffer);
+}
+
 void Framebuffer::update(const std::vector<unsigned char>& buffer)
 {
     glBindTexture(GL_TEXTURE_2D, _textureID);
     //glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, _width, _height, 0, GL_RGB, GL_UNSIGNED_BYTE, buffer.data());
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, buffer.data());
+
+    const int index = _nextPixelBuffer;
+    if (!_pixelBufferData[index])
+    {
+        // The driver copies the client memory before returning
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, buffer.data());
+        return;
+    }
+    _nextPixelBuffer = (index + 1) % PIXEL_BUFFER_COUNT;
+
+    // Only waits when the frames come faster than PIXEL_BUFFER_COUNT uploads
+    if (_fences[index])
+    {
+        glClientWaitSync(_fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(_fences[index]);
+    }
+
+    // RGBA matches the texture storage, drivers copy it as is where RGB needs a conversion
+    // (5x slower with llvmpipe). Written byte by byte: no assumption on the endianness
+    const int pixels = _width * _height;
+    const unsigned char* source = buffer.data();
+    unsigned char* destination = _pixelBufferData[index];
+    for (int i = 0; i < pixels; ++i, source += 3, destination += 4)
+    {
+        destination[0] = source[0];
+        destination[1] = source[1];
+        destination[2] = source[2];
+        destination[3] = 255;
+    }
+
+    // With a pixel buffer bound the data pointer is an offset in it, the upload is queued
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pixelBuffers[index]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    _fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
 
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <glad/glad.h>
 #include <vector>
 
+#include "RenderOutput.hpp"
 
-class Framebuffer
+
+class Framebuffer : public RenderOutput
 {
 public:
 	Framebuffer(float width, float height, const std::vector<unsigned char>& buffer);
@@ -18,9 +21,27 @@ public:
 
 	void free();
 
+	// Upload a frame of the framebuffer size into the texture
 	void update(const std::vector<unsigned char>& buffer);
 
+	// Frames of another size reallocate the texture first (e.g. after a resize of the render)
+	void present(const std::vector<unsigned char>& buffer, int width, int height) override;
+
+private:
+	// Ring of persistently mapped pixel buffers (OpenGL 4.4), update() uploads from client memory without it
+	void createPixelBuffers();
+	void freePixelBuffers();
+
 private:
+	// Frames in flight: update() copies a frame into the next buffer of the ring and the texture upload
+	// from it runs asynchronously, a fence per buffer keeps it from being overwritten before that upload is done
+	static const int PIXEL_BUFFER_COUNT = 3;
+
+	unsigned int _pixelBuffers[PIXEL_BUFFER_COUNT] = {};
+	unsigned char* _pixelBufferData[PIXEL_BUFFER_COUNT] = {};
+	GLsync _fences[PIXEL_BUFFER_COUNT] = {};
+	int _nextPixelBuffer = 0;
+
 	unsigned int _id;
 	unsigned int _textureID;
 	unsigned int _rboID;
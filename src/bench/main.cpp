@@ -0,0 +1,537 @@
+// Micro-benchmarks of the marching hot path
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "RayMarching.hpp"
+
+
+struct BenchmarkOptions
+{
+    std::string filter;
+    int repetitions = 10;
+    double minSampleMs = 20.0;
+    int width = 160;
+    int height = 120;
+};
+
+static BenchmarkOptions options;
+
+// Keep results alive so the compiler cannot drop the benchmarked calls
+static volatile float sink = 0.0f;
+
+struct BenchmarkResult
+{
+    double medianNs = 0.0; // per operation
+    double minNs = 0.0;
+    double stddevNs = 0.0;
+};
+
+// Run `func` (which performs `opsPerCall` operations) until the timing is stable:
+// one warmup sample, then `repetitions` samples of at least `minSampleMs` each
+static BenchmarkResult measure(const std::function<void()>& func, double opsPerCall)
+{
+    using clock = std::chrono::steady_clock;
+
+    // Warmup and calibration of the number of calls per sample
+    long long calls = 1;
+    while (true)
+    {
+        auto start = clock::now();
+        for (long long i = 0; i < calls; ++i)
+            func();
+        double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        if (ms >= options.minSampleMs)
+            break;
+        calls *= (ms < options.minSampleMs / 10.0) ? 10 : 2;
+    }
+
+    std::vector<double> samples;
+    for (int r = 0; r < options.repetitions; ++r)
+    {
+        auto start = clock::now();
+        for (long long i = 0; i < calls; ++i)
+            func();
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        samples.push_back(ns / (calls * opsPerCall));
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    double mean = 0.0;
+    for (double s : samples)
+        mean += s;
+    mean /= samples.size();
+
+    double variance = 0.0;
+    for (double s : samples)
+        variance += (s - mean) * (s - mean);
+    variance /= samples.size();
+
+    BenchmarkResult result;
+    result.medianNs = samples[samples.size() / 2];
+    result.minNs = samples.front();
+    result.stddevNs = std::sqrt(variance);
+    return result;
+}
+
+static bool selected(const std::string& name)
+{
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+static void report(const std::string& name, const BenchmarkResult& result, const std::string& extra = "")
+{
+    std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(2)
+        << std::setw(14) << result.medianNs << " ns/op"
+        << std::setw(12) << result.minNs << " min"
+        << std::setw(10) << result.stddevNs << " sd"
+        << "  " << extra << std::endl;
+}
+
+static std::string perSecond(double count, double ns, const char* unit)
+{
+    double value = count / (ns * 1e-9);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    if (value >= 1e6)
+        out << value / 1e6 << " M" << unit << "/s";
+    else
+        out << value / 1e3 << " k" << unit << "/s";
+    return out.str();
+}
+
+// Spheres on a grid in front of the camera, every other one blended unless unionOnly
+static std::vector<Shape> makeScene(int count, bool unionOnly = false)
+{
+    std::vector<Shape> shapes;
+    int side = (int)std::ceil(std::cbrt((double)count));
+    float spacing = 2.0f / side;
+    for (int i = 0; i < count; ++i)
+    {
+        glm::vec3 position = glm::vec3(i % side, (i / side) % side, i / (side * side)) * spacing - glm::vec3(1.0f);
+        Shape shape(position, glm::vec3(spacing * 0.4f), { 255, 150, 0 }, "Sphere " + std::to_string(i));
+        if (i % 2 && !unionOnly)
+        {
+            shape.operation = EOperation::BLEND;
+        }
+        shapes.push_back(shape);
+    }
+    return shapes;
+}
+
+// Random points around the scene, the same sequence for every run
+static std::vector<Ray> makePoints(int count)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-3.0f, 3.0f);
+    std::vector<Ray> points;
+    for (int i = 0; i < count; ++i)
+    {
+        points.push_back(Ray({ dist(rng), dist(rng), dist(rng) }));
+    }
+    return points;
+}
+
+static void benchShapeDistance(RayMarchingManager& rayMarching, const std::vector<Ray>& points)
+{
+    const Shape shape({ 0, 0, 0 }, { 1, 1, 1 }, { 255, 150, 0 }, "Sphere");
+
+    for (bool pga : { true, false })
+    {
+        std::string name = std::string("GetShapeDistance/") + (pga ? "pga" : "glm");
+        if (!selected(name))
+            continue;
+
+        rayMarching.getUsePGA() = pga;
+        rayMarching.applyChanges();
+        auto result = measure([&]() {
+            float acc = 0.0f;
+            for (const Ray& p : points)
+                acc += rayMarching.GetShapeDistance(shape, p);
+            sink = sink + acc;
+        }, (double)points.size());
+        report(name, result);
+    }
+    rayMarching.getUsePGA() = true;
+}
+
+// A scene query benchmark: setup configures a new manager, then getSceneInfo() (or getSceneDistance())
+// is evaluated at each point, reported per shape
+struct QueryBench
+{
+    std::string name;
+    int shapes;
+    bool distanceOnly;
+    std::function<void(RayMarchingManager&)> setup;
+};
+
+static void runQueryBench(const QueryBench& bench, const std::vector<Ray>& points)
+{
+    if (!selected(bench.name))
+        return;
+
+    RayMarchingManager rayMarching(options.width, options.height);
+    bench.setup(rayMarching);
+    rayMarching.applyChanges();
+
+    auto result = measure([&]() {
+        float acc = 0.0f;
+        for (const Ray& p : points)
+            acc += bench.distanceOnly ? rayMarching.getSceneDistance(p) : rayMarching.getSceneInfo(p).w;
+        sink = sink + acc;
+    }, (double)points.size());
+    report(bench.name, result, perSecond(bench.shapes, result.medianNs, "shapes"));
+}
+
+static void benchSceneInfo(const std::vector<Ray>& points)
+{
+    std::vector<QueryBench> benches;
+
+    // Half blended scenes, with the colors and without them as evaluated at each march step
+    for (bool distanceOnly : { false, true })
+    {
+        for (int count : { 1, 16, 256 })
+        {
+            benches.push_back({ (distanceOnly ? "getSceneDistance/" : "getSceneInfo/") + std::to_string(count), count, distanceOnly,
+                [=](RayMarchingManager& rayMarching) { rayMarching.setShapes(makeScene(count)); } });
+        }
+    }
+
+    // DEFAULT shapes only, evaluated simd::LANES at a time on the glm path
+    for (bool pga : { true, false })
+    {
+        for (int count : { 16, 256 })
+        {
+            benches.push_back({ "getSceneInfo/union/" + std::to_string(count) + (pga ? "/pga" : "/glm"), count, false,
+                [=](RayMarchingManager& rayMarching) {
+                    rayMarching.setShapes(makeScene(count, true));
+                    rayMarching.getUsePGA() = pga;
+                } });
+        }
+    }
+
+    // Large union scenes through the BVH
+    for (bool bvh : { true, false })
+    {
+        for (int count : { 1024, 8192 })
+        {
+            benches.push_back({ "getSceneInfo/large/" + std::to_string(count) + (bvh ? "/bvh" : "/linear"), count, false,
+                [=](RayMarchingManager& rayMarching) {
+                    rayMarching.setShapes(makeScene(count, true));
+                    rayMarching.getUseBVH() = bvh;
+                    rayMarching.getUsePGA() = false;
+                } });
+        }
+    }
+
+    // Half blended scenes: the blend margin makes most BVH queries overflow, the BVH is then left out
+    for (bool bvh : { true, false })
+    {
+        benches.push_back({ std::string("getSceneInfo/large/blend/2048/") + (bvh ? "bvh" : "linear"), 2048, false,
+            [=](RayMarchingManager& rayMarching) {
+                rayMarching.setShapes(makeScene(2048));
+                rayMarching.getUseBVH() = bvh;
+            } });
+    }
+
+    for (const QueryBench& bench : benches)
+        runQueryBench(bench, points);
+}
+
+static void benchCombine()
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(0.0f, 2.0f);
+    std::vector<float> distances(1024);
+    for (float& d : distances)
+        d = dist(rng);
+
+    const glm::vec3 colorA(255, 150, 0);
+    const glm::vec3 colorB(0, 150, 0);
+
+    if (selected("Combine/default"))
+    {
+        auto result = measure([&]() {
+            float acc = 0.0f;
+            for (size_t i = 1; i < distances.size(); ++i)
+                acc += Combine(distances[i - 1], distances[i], colorA, colorB, EOperation::DEFAULT, 0.1f).w;
+            sink = sink + acc;
+        }, (double)distances.size() - 1);
+        report("Combine/default", result);
+    }
+
+    if (selected("Blend"))
+    {
+        auto result = measure([&]() {
+            float acc = 0.0f;
+            for (size_t i = 1; i < distances.size(); ++i)
+                acc += Blend(distances[i - 1], distances[i], colorA, colorB, 0.1f).w;
+            sink = sink + acc;
+        }, (double)distances.size() - 1);
+        report("Blend", result);
+    }
+}
+
+static void benchNormal(RayMarchingManager& rayMarching)
+{
+    if (!selected("estimateNormal"))
+        return;
+
+    rayMarching.setShapes(makeScene(16));
+
+    // Points close to the surface of the spheres, as after a hit
+    std::vector<glm::vec3> points;
+    for (const Shape& shape : rayMarching.getShapes())
+    {
+        for (const Ray& p : makePoints(16))
+            points.push_back(shape.position + glm::normalize(p.origin) * shape.size.x);
+    }
+
+    const std::pair<ENormalMode, const char*> modes[] = {
+        { ENormalMode::CENTRAL_DIFFERENCES, "central" },
+        { ENormalMode::TETRAHEDRON, "tetrahedron" },
+        { ENormalMode::ANALYTIC, "analytic" },
+    };
+
+    for (const auto& mode : modes)
+    {
+        rayMarching.getNormalMode() = mode.first;
+        rayMarching.applyChanges();
+        auto result = measure([&]() {
+            float acc = 0.0f;
+            for (const glm::vec3& p : points)
+                acc += rayMarching.estimateNormal(p).x;
+            sink = sink + acc;
+        }, (double)points.size());
+        report(std::string("estimateNormal/16/") + mode.second, result);
+    }
+    rayMarching.getNormalMode() = ENormalMode::ANALYTIC;
+}
+
+static void benchCameraRay(RayMarchingManager& rayMarching)
+{
+    if (!selected("createCameraRay"))
+        return;
+
+    const int width = options.width;
+    const int height = options.height;
+    auto result = measure([&]() {
+        float acc = 0.0f;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                glm::vec2 uv = glm::vec2(x / (float)width, y / (float)height) * 2.0f - 1.0f;
+                acc += rayMarching.createCameraRay(uv).direction.x;
+            }
+        }
+        sink = sink + acc;
+    }, (double)width * height);
+    report("createCameraRay", result, perSecond(1.0, result.medianNs, "rays"));
+}
+
+// A frame benchmark: setup configures a new manager, then each timed frame applies frame(manager, index),
+// or invalidates the view when there is none, and calls update()
+struct FrameBench
+{
+    std::string name;
+    std::function<void(RayMarchingManager&)> setup;
+    std::function<void(RayMarchingManager&, int)> frame;
+};
+
+static void runFrameBench(const FrameBench& bench)
+{
+    if (!selected(bench.name))
+        return;
+
+    RayMarchingManager rayMarching(options.width, options.height);
+    bench.setup(rayMarching);
+
+    // Frames re-rendering part of the image start from a rendered one
+    rayMarching.update();
+
+    int index = 0;
+    auto result = measure([&]() {
+        if (bench.frame)
+            bench.frame(rayMarching, index++);
+        else
+            rayMarching.UpdateView();
+        rayMarching.update();
+    }, 1.0);
+
+    // A shading pass marches no ray
+    const RayMarchingStats& stats = rayMarching.getStats();
+    report(bench.name, result, stats.rays == 0 ? "" : perSecond((double)stats.rays, result.medianNs, "rays") + ", "
+        + perSecond((double)stats.marchSteps, result.medianNs, "steps"));
+}
+
+static void benchFrame()
+{
+    std::vector<FrameBench> benches;
+
+    for (bool packets : { true, false })
+    {
+        for (int count : { 1, 16, 128 })
+        {
+            benches.push_back({ "update/" + std::to_string(count) + (packets ? "/packets" : "/scalar"),
+                [=](RayMarchingManager& rayMarching) {
+                    rayMarching.setShapes(makeScene(count));
+                    rayMarching.getUsePackets() = packets;
+                } });
+        }
+    }
+
+    // Large half blended scene, see getSceneInfo/large/blend
+    for (bool bvh : { true, false })
+    {
+        benches.push_back({ std::string("update/blend/2048/") + (bvh ? "bvh" : "linear"),
+            [=](RayMarchingManager& rayMarching) {
+                rayMarching.setShapes(makeScene(2048));
+                rayMarching.getUseBVH() = bvh;
+            } });
+    }
+
+    // Scene of unions only, intersected in closed form or marched
+    for (bool analytic : { true, false })
+    {
+        benches.push_back({ std::string("update/union/128/") + (analytic ? "analytic" : "marched"),
+            [=](RayMarchingManager& rayMarching) {
+                rayMarching.setShapes(makeScene(128, true));
+                rayMarching.getAnalyticSpheres() = analytic;
+            } });
+    }
+
+    // Rays folding the shapes binned into their tile or every shape
+    for (bool binned : { true, false })
+    {
+        benches.push_back({ std::string("update/binning/128/") + (binned ? "tiles" : "all"),
+            [=](RayMarchingManager& rayMarching) {
+                rayMarching.setShapes(makeScene(128));
+                rayMarching.getTileBinning() = binned;
+            } });
+    }
+
+    // First sample of each frame while the camera orbits the scene by half a degree per frame
+    for (const char* mode : { "cold", "reprojection", "checkerboard" })
+    {
+        const bool reprojection = !std::strcmp(mode, "reprojection");
+        const bool checkerboard = !std::strcmp(mode, "checkerboard");
+        benches.push_back({ std::string("update/orbit/16/") + mode,
+            [=](RayMarchingManager& rayMarching) {
+                rayMarching.setShapes(makeScene(16));
+                rayMarching.setMaxSamples(1);
+                rayMarching.getReprojection() = reprojection;
+                rayMarching.getCheckerboard() = checkerboard;
+            },
+            [](RayMarchingManager& rayMarching, int) {
+                Camera& camera = rayMarching.getCamera();
+                const glm::vec3 eye = camera._eye;
+                const float angle = glm::radians(0.5f);
+                camera._eye = glm::vec3(eye.x * std::cos(angle) - eye.z * std::sin(angle), eye.y, eye.x * std::sin(angle) + eye.z * std::cos(angle));
+                camera.updateCamera();
+                rayMarching.UpdateView();
+            } });
+    }
+
+    // Interactive frames while one shape is dragged, whole frame or only the pixels it covers
+    for (bool partial : { false, true })
+    {
+        benches.push_back({ std::string("update/move/64/") + (partial ? "shape" : "scene"),
+            [](RayMarchingManager& rayMarching) {
+                rayMarching.setShapes(makeScene(64));
+                rayMarching.setMaxSamples(1);
+            },
+            [=](RayMarchingManager& rayMarching, int index) {
+                Shape& shape = rayMarching.getShapeAtIndex(0);
+                shape.position.x += index % 2 ? -0.01f : 0.01f;
+                shape.center = { shape.position.x, shape.position.y, shape.position.z };
+                if (partial)
+                    rayMarching.UpdateShape(0);
+                else
+                    rayMarching.UpdateScene();
+            } });
+    }
+
+    // Frames after a change of the light, marched again or shaded from the G-buffer
+    for (bool shading : { false, true })
+    {
+        benches.push_back({ std::string("update/light/64/") + (shading ? "lighting" : "scene"),
+            [](RayMarchingManager& rayMarching) {
+                rayMarching.setShapes(makeScene(64));
+                rayMarching.setMaxSamples(1);
+            },
+            [=](RayMarchingManager& rayMarching, int index) {
+                const float angle = glm::radians(5.0f) * (index + 1);
+                rayMarching.getLight() = glm::vec3(std::cos(angle), 0.9f, std::sin(angle));
+                if (shading)
+                    rayMarching.UpdateLighting();
+                else
+                    rayMarching.UpdateScene();
+            } });
+    }
+
+    for (const FrameBench& bench : benches)
+        runFrameBench(bench);
+}
+
+static void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]" << std::endl
+        << "  --filter <text>        Only run benchmarks whose name contains text" << std::endl
+        << "  --repetitions <n>      Timed samples per benchmark (default 10)" << std::endl
+        << "  --min-time <ms>        Minimum duration of a sample (default 20)" << std::endl
+        << "  --width <n>            Frame width for update() (default 160)" << std::endl
+        << "  --height <n>           Frame height for update() (default 120)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        bool hasValue = i + 1 < argc;
+
+        if (!std::strcmp(argv[i], "--filter") && hasValue)
+            options.filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--repetitions") && hasValue)
+            options.repetitions = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--min-time") && hasValue)
+            options.minSampleMs = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--width") && hasValue)
+            options.width = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--height") && hasValue)
+            options.height = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            printUsage(argv[0]);
+            return !std::strcmp(argv[i], "--help") ? 0 : -1;
+        }
+    }
+
+#ifndef NDEBUG
+    std::cout << "WARNING: benchmarks built without NDEBUG, use CMAKE_BUILD_TYPE=Release" << std::endl;
+#endif
+
+    RayMarchingManager rayMarching(options.width, options.height);
+    const std::vector<Ray> points = makePoints(1024);
+
+    benchShapeDistance(rayMarching, points);
+    benchSceneInfo(points);
+    benchCombine();
+    benchNormal(rayMarching);
+    benchCameraRay(rayMarching);
+    benchFrame();
+
+    return 0;
+}
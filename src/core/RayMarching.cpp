@@ -0,0 +1,1998 @@
+#include "RayMarching.hpp"
+
+#include "glm/gtx/transform.hpp"
+#include "glm/gtx/compatibility.hpp"
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+
+// Clamp between [0.0, 1.0]
+float saturate(float x)
+{
+    return x > 1.f ? 1.f : (x < 0.f ? 0.f : x);
+}
+
+static const glm::vec3 BACKGROUND_COLOR = glm::vec3(120);
+
+// Radical inverse of index in base, low discrepancy sequence in [0, 1) starting at 0
+static float halton(int index, int base)
+{
+    float result = 0.0f;
+    float fraction = 1.0f;
+    for (; index > 0; index /= base)
+    {
+        fraction /= base;
+        result += fraction * (index % base);
+    }
+    return result;
+}
+
+// Shape at position c of a list, or of the scene without one
+static int shapeIndex(const ShapeList* shapes, int c)
+{
+    return shapes ? shapes->indices[c] : c;
+}
+
+float lerp(float start, float end, float t)
+{
+    return start * (1 - t) + end * t;
+}
+
+glm::vec3 lerp(const glm::vec3& start, const glm::vec3& end, float t)
+{
+    return start * (1 - t) + end * t;
+}
+
+float RayMarchingManager::GetShapeDistance(const Shape& shape, const Ray& eye)
+{
+    if (_settings.useP3GA)
+    {
+       kln::line line = eye.org & shape.center;
+       return line.norm() - shape.size.x;
+    }
+    else
+    {
+        return glm::distance(eye.origin, shape.position) - shape.size.x;
+    }
+    
+    //if (shape.shapeType == 0) {
+    //    return SphereDistance(eye, shape.position, shape.size.x);
+    //}
+    //else if (shape.shapeType == 1) {
+    //    return CubeDistance(eye, shape.position, shape.size);
+    //}
+    //else if (shape.shapeType == 2) {
+    //    return TorusDistance(eye, shape.position, shape.size.x, shape.size.y);
+    //}
+
+    //return maxDst;
+}
+
+// polynomial smooth min (k = 0.1);
+// from https://www.iquilezles.org/www/articles/smin/smin.htm
+glm::vec4 Blend(float a, float b, const glm::vec3& colA, const glm::vec3& colB, float k)
+{
+    float h = saturate(0.5f + 0.5f * (b - a) / k);
+    float blendDst = lerp(b, a, h) - k * h * (1.0f - h);
+    glm::vec3 blendCol = glm::lerp(colB, colA, h);
+    return glm::vec4(blendCol, blendDst);
+}
+
+float BlendDistance(float a, float b, float k)
+{
+    float h = saturate(0.5f + 0.5f * (b - a) / k);
+    return lerp(b, a, h) - k * h * (1.0f - h);
+}
+
+glm::vec4 Combine(float dstA, float dstB, const glm::vec3& colorA, const glm::vec3& colorB, EOperation operation, float blendStrength)
+{
+    switch (operation)
+    {
+    case EOperation::DEFAULT:
+        if (dstB < dstA)
+        {
+            return glm::vec4(colorB, dstB);
+        }
+        break;
+    case EOperation::BLEND:
+        return(Blend(dstA, dstB, colorA, colorB, blendStrength));
+    }
+
+    //// Cut
+    //else if (operation == 2) {
+    //    // max(a,-b)
+    //    if (-dstB > dst) {
+    //        dst = -dstB;
+    //        colour = colourB;
+    //    }
+    //}
+    //// Mask
+    //else if (operation == 3) {
+    //    // max(a,b)
+    //    if (dstB > dst) {
+    //        dst = dstB;
+    //        colour = colourB;
+    //    }
+    //}
+
+    return glm::vec4(colorA, dstA);
+}
+
+float CombineDistance(float dstA, float dstB, EOperation operation, float blendStrength)
+{
+    switch (operation)
+    {
+    case EOperation::DEFAULT:
+        return dstB < dstA ? dstB : dstA;
+    case EOperation::BLEND:
+        return BlendDistance(dstA, dstB, blendStrength);
+    }
+
+    return dstA;
+}
+
+RayMarchingManager::RayMarchingManager(int width, int height, int threadCount)
+    : _camera(Camera(width, height)),
+    _editCamera(_camera),
+    _width(width),
+    _height(height),
+    _nbpixels(_width * _height),
+    _bufferSize(_nbpixels * 3 /* RGB */),
+    _buffer(std::vector<unsigned char>(_bufferSize)),
+    _threadPool(threadCount)
+{
+    int value = 125;
+    for (int i = 0; i < _bufferSize; ++i)
+    {
+        _buffer[i] = (unsigned char)(value);
+    }
+
+    _editSettings.shapes = std::vector<Shape>({
+        //    position   size       color
+        Shape({0, 0, 0}, { 1, 1, 1 }, {255, 150, 0}, "Orange Sphere"),
+        //Shape({1, 1, 0}, { .75, .75, .75}, {0, 150, 0}, "Green Sphere")
+    });
+
+    setRenderSize(_width, _height);
+    applyChanges();
+}
+
+void RayMarchingManager::applyChanges()
+{
+    // Every setting but the shape table, the frame reads the shapes through _scene
+    std::vector<Shape> shapes;
+    shapes.swap(_editSettings.shapes);
+    _settings = _editSettings;
+    _editSettings.shapes.swap(shapes);
+
+    if (_viewChanged)
+    {
+        _camera = _editCamera;
+        _rayOrigin = _camera.getCameraToWorld() * glm::vec4(0, 0, 0, 1);
+        _needToUpdateRays = true;
+        _reprojectionPending = _hitPointsValid;
+        restartSamples();
+    }
+
+    if (_sceneChanged)
+    {
+        _scene.build(_editSettings.shapes, _editSettings.numShapes);
+        buildBVH();
+        restartSamples();
+        _hitPointsValid = false;
+        _reprojectionPending = false;
+    }
+    else if (!_changedShapes.empty())
+    {
+        applyShapeChanges();
+    }
+
+    if (_restartPending)
+    {
+        restartSamples();
+    }
+
+    // Marching anyway: the first sample shades with the new lighting, everywhere
+    if (_lightingChanged)
+    {
+        if (currentSample > 0)
+        {
+            _shadingFrame = true;
+        }
+        else
+        {
+            restartSamples();
+        }
+    }
+
+    // A shading pass gives every pixel its first sample again, the rule applies from there
+    if (_samplingChanged && !_shadingFrame)
+    {
+        applySamplingChange();
+    }
+
+    _viewChanged = false;
+    _sceneChanged = false;
+    _restartPending = false;
+    _lightingChanged = false;
+    _samplingChanged = false;
+    _changedShapes.clear();
+}
+
+void RayMarchingManager::setRenderSize(int width, int height)
+{
+    _renderWidth = width;
+    _renderHeight = height;
+    _renderPixels = width * height;
+
+    _renderBuffer.resize(_renderPixels * 3);
+    _rays.resize(_renderPixels);
+    _accumulation.resize(_renderPixels * 3);
+    _sampleCount.resize(_renderPixels);
+    _luminanceSq.resize(_renderPixels);
+    _converged.resize(_renderPixels);
+    _hitPoints.resize(_renderPixels);
+    _hasHit.resize(_renderPixels);
+    _reprojectedDst.resize(_renderPixels);
+    _gbufferPoint.resize(_renderPixels);
+    _gbufferNormal.resize(_renderPixels);
+    _gbufferColor.resize(_renderPixels);
+    _gbufferShape.resize(_renderPixels);
+
+    // The image is laid out for the previous size, the next frame marches every pixel
+    _renderBufferValid = false;
+}
+
+void RayMarchingManager::setRenderScale(float scale)
+{
+    _renderScale = scale;
+
+    const int width = std::max(1, (int)std::lround(_width * scale));
+    const int height = std::max(1, (int)std::lround(_height * scale));
+    if (width == _renderWidth && height == _renderHeight)
+    {
+        return;
+    }
+
+    // Every per pixel state is for the previous size
+    setRenderSize(width, height);
+    restartSamples();
+    _needToUpdateRays = true;
+    _hitPointsValid = false;
+    _reprojectionPending = false;
+}
+
+void RayMarchingManager::updateRenderScale(float frameMs)
+{
+    // The cost of a frame is proportional to its number of pixels
+    const float target = glm::clamp(_renderScale * std::sqrt(_settings.frameBudgetMs / std::max(frameMs, 0.01f)),
+        _settings.minRenderScale, 1.0f);
+
+    // Small corrections are ignored so that the scale settles and samples keep accumulating
+    if (std::abs(target - _renderScale) > 0.1f * _renderScale)
+    {
+        setRenderScale(target);
+    }
+}
+
+void RayMarchingManager::upscale()
+{
+    if (_renderWidth == _width && _renderHeight == _height)
+    {
+        std::copy(_renderBuffer.begin(), _renderBuffer.end(), _buffer.begin());
+        return;
+    }
+
+    // Bilinear, render pixel x covers the uv of output pixel x * _width / _renderWidth
+    const float scaleX = _renderWidth / (float)_width;
+    const float scaleY = _renderHeight / (float)_height;
+
+    const int rowBlocks = (_height + TILE_SIZE - 1) / TILE_SIZE;
+    _threadPool.parallelFor(rowBlocks, [&](int block)
+    {
+        for (int y = block * TILE_SIZE; y < std::min((block + 1) * TILE_SIZE, _height); ++y)
+        {
+            const float sy = std::min(y * scaleY, _renderHeight - 1.0f);
+            const int y0 = (int)sy;
+            const int y1 = std::min(y0 + 1, _renderHeight - 1);
+            const float ty = sy - y0;
+
+            for (int x = 0; x < _width; ++x)
+            {
+                const float sx = std::min(x * scaleX, _renderWidth - 1.0f);
+                const int x0 = (int)sx;
+                const int x1 = std::min(x0 + 1, _renderWidth - 1);
+                const float tx = sx - x0;
+
+                const unsigned char* p00 = &_renderBuffer[(y0 * _renderWidth + x0) * 3];
+                const unsigned char* p10 = &_renderBuffer[(y0 * _renderWidth + x1) * 3];
+                const unsigned char* p01 = &_renderBuffer[(y1 * _renderWidth + x0) * 3];
+                const unsigned char* p11 = &_renderBuffer[(y1 * _renderWidth + x1) * 3];
+                unsigned char* out = &_buffer[(y * _width + x) * 3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    const float top = lerp(p00[c], p10[c], tx);
+                    const float bottom = lerp(p01[c], p11[c], tx);
+                    out[c] = (unsigned char)(lerp(top, bottom, ty) + 0.5f);
+                }
+            }
+        }
+    });
+}
+
+
+Ray RayMarchingManager::createCameraRay(const glm::vec2& uv)
+{
+    glm::vec3 direction = _camera.getCameraInverseProjection() * glm::vec4(uv, 0, 1);
+    direction = _camera.getCameraToWorld() * glm::vec4(direction, 0);
+    direction = normalize(direction);
+    return Ray(_rayOrigin, direction);
+}
+
+glm::vec4 RayMarchingManager::getSceneInfo(const Ray& eye, const ShapeList* shapes)
+{
+    const SceneData& scene = _scene;
+
+    float globalDst = _settings.maxDst;
+    glm::vec3 globalColour = glm::vec3(1);
+
+    // The shapes of the list, or the BVH candidates
+    int candidates[BVH_MAX_CANDIDATES];
+    const int* indices = shapes ? shapes->indices : candidates;
+    const int candidateCount = shapes ? shapes->count : gatherShapes(eye.origin, candidates);
+    if (candidateCount >= 0)
+    {
+        for (int c = 0; c < candidateCount; c++) {
+            const int i = indices[c];
+            float localDst = glm::distance(eye.origin, glm::vec3(scene.x[i], scene.y[i], scene.z[i])) - scene.radius[i];
+            const glm::vec3 localColour(scene.colorR[i], scene.colorG[i], scene.colorB[i]);
+
+            glm::vec4 globalCombined = Combine(globalDst, localDst, globalColour, localColour, scene.operation[i], scene.blendStrength[i]);
+            globalColour = globalCombined;
+            globalDst = globalCombined.w;
+        }
+
+        return glm::vec4(globalColour, globalDst);
+    }
+
+    if (_settings.useP3GA)
+    {
+        for (int i = 0; i < scene.count; i++) {
+            kln::line line = eye.org & scene.center[i];
+            float localDst = line.norm() - scene.radius[i];
+            const glm::vec3 localColour(scene.colorR[i], scene.colorG[i], scene.colorB[i]);
+
+            glm::vec4 globalCombined = Combine(globalDst, localDst, globalColour, localColour, scene.operation[i], scene.blendStrength[i]);
+            globalColour = globalCombined;
+            globalDst = globalCombined.w;
+        }
+
+        return glm::vec4(globalColour, globalDst);
+    }
+
+    for (const SceneRun& run : scene.runs) {
+        int i = run.begin;
+
+        // A union only keeps the closest shape: evaluate simd::LANES shapes at once
+        if (run.operation == EOperation::DEFAULT)
+        {
+            int closest = -1;
+            float closestDst = 0.0f;
+            i = nearestShape(run, eye.origin, closest, closestDst);
+            if (closest >= 0 && closestDst < globalDst)
+            {
+                globalDst = closestDst;
+                globalColour = glm::vec3(scene.colorR[closest], scene.colorG[closest], scene.colorB[closest]);
+            }
+        }
+
+        // Blended shapes, and the remainder of a union run
+        for (; i < run.end; i++) {
+            float localDst = glm::distance(eye.origin, glm::vec3(scene.x[i], scene.y[i], scene.z[i])) - scene.radius[i];
+            const glm::vec3 localColour(scene.colorR[i], scene.colorG[i], scene.colorB[i]);
+
+            glm::vec4 globalCombined = Combine(globalDst, localDst, globalColour, localColour, scene.operation[i], scene.blendStrength[i]);
+            globalColour = globalCombined;
+            globalDst = globalCombined.w;
+        }
+    }
+
+    return glm::vec4(globalColour, globalDst);
+}
+
+float RayMarchingManager::getSceneDistance(const Ray& eye, const ShapeList* shapes)
+{
+    const SceneData& scene = _scene;
+
+    float globalDst = _settings.maxDst;
+
+    // The shapes of the list, or the BVH candidates
+    int candidates[BVH_MAX_CANDIDATES];
+    const int* indices = shapes ? shapes->indices : candidates;
+    const int candidateCount = shapes ? shapes->count : gatherShapes(eye.origin, candidates);
+    if (candidateCount >= 0)
+    {
+        for (int c = 0; c < candidateCount; c++) {
+            const int i = indices[c];
+            float localDst = glm::distance(eye.origin, glm::vec3(scene.x[i], scene.y[i], scene.z[i])) - scene.radius[i];
+            globalDst = CombineDistance(globalDst, localDst, scene.operation[i], scene.blendStrength[i]);
+        }
+
+        return globalDst;
+    }
+
+    if (_settings.useP3GA)
+    {
+        for (int i = 0; i < scene.count; i++) {
+            kln::line line = eye.org & scene.center[i];
+            float localDst = line.norm() - scene.radius[i];
+            globalDst = CombineDistance(globalDst, localDst, scene.operation[i], scene.blendStrength[i]);
+        }
+
+        return globalDst;
+    }
+
+    for (const SceneRun& run : scene.runs) {
+        int i = run.begin;
+
+        if (run.operation == EOperation::DEFAULT)
+        {
+            int closest = -1;
+            float closestDst = 0.0f;
+            i = nearestShape(run, eye.origin, closest, closestDst);
+            if (closest >= 0 && closestDst < globalDst)
+            {
+                globalDst = closestDst;
+            }
+        }
+
+        for (; i < run.end; i++) {
+            float localDst = glm::distance(eye.origin, glm::vec3(scene.x[i], scene.y[i], scene.z[i])) - scene.radius[i];
+            globalDst = CombineDistance(globalDst, localDst, scene.operation[i], scene.blendStrength[i]);
+        }
+    }
+
+    return globalDst;
+}
+
+void RayMarchingManager::buildBVH()
+{
+    _bvh.build(_scene);
+    _bvhSelective = _scene.count < BVH_MIN_SHAPES
+        || _bvh.overflowRate(_scene, _settings.maxDst, BVH_MAX_CANDIDATES, BVH_PROBES) <= BVH_MAX_OVERFLOW;
+}
+
+int RayMarchingManager::gatherShapes(const glm::vec3& p, int* indices) const
+{
+    if (!useBVH())
+    {
+        return -1;
+    }
+
+    return _bvh.gather(_scene, p, _settings.maxDst, indices, BVH_MAX_CANDIDATES);
+}
+
+bool RayMarchingManager::useAnalyticSpheres(const ShapeList* shapes) const
+{
+    if (!_settings.analyticSpheres || useBVH())
+    {
+        return false;
+    }
+
+    if (!shapes)
+    {
+        return _scene.runs.size() == 1 && _scene.runs[0].operation == EOperation::DEFAULT;
+    }
+
+    for (int c = 0; c < shapes->count; ++c)
+    {
+        if (_scene.operation[shapes->indices[c]] == EOperation::BLEND)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RayMarchingManager::binShapes(int tilesX, int tilesY)
+{
+    const SceneData& scene = _scene;
+    const int tileCount = tilesX * tilesY;
+
+    // Counting pass, _tileShapeStart[t + 1] is the size of tile t until the prefix sum
+    _shapeTiles.resize(scene.count);
+    _tileShapeStart.assign(tileCount + 1, 0);
+    for (int i = 0; i < scene.count; ++i)
+    {
+        // Same reach as for an edit of the shape, see applyShapeChanges()
+        const glm::vec3 center(scene.x[i], scene.y[i], scene.z[i]);
+        const float radius = scene.radius[i] + scene.reach[i] + _bvh.getBlendMargin() + _settings.epsilon;
+
+        // One pixel more on each side for the sub-pixel offsets of the samples
+        glm::ivec4& tiles = _shapeTiles[i];
+        tiles = glm::ivec4(0, 0, -1, -1);
+        glm::vec2 pixelMin, pixelMax;
+        if (!projectSphere(center, radius, pixelMin, pixelMax)
+            || pixelMax.x < -1.0f || pixelMax.y < -1.0f || pixelMin.x > _renderWidth || pixelMin.y > _renderHeight)
+        {
+            continue;
+        }
+        tiles.x = (int)std::max(std::floor(pixelMin.x) - 1.0f, 0.0f) / TILE_SIZE;
+        tiles.y = (int)std::max(std::floor(pixelMin.y) - 1.0f, 0.0f) / TILE_SIZE;
+        tiles.z = (int)std::min(std::floor(pixelMax.x) + 1.0f, (float)_renderWidth - 1) / TILE_SIZE;
+        tiles.w = (int)std::min(std::floor(pixelMax.y) + 1.0f, (float)_renderHeight - 1) / TILE_SIZE;
+
+        for (int ty = tiles.y; ty <= tiles.w; ++ty)
+        {
+            for (int tx = tiles.x; tx <= tiles.z; ++tx)
+            {
+                _tileShapeStart[ty * tilesX + tx + 1]++;
+            }
+        }
+    }
+
+    for (int tile = 0; tile < tileCount; ++tile)
+    {
+        _tileShapeStart[tile + 1] += _tileShapeStart[tile];
+    }
+
+    // Shapes are appended in order, each list is in fold order. _tileShapeStart[t] moves to the end
+    // of tile t, i.e. the start of tile t + 1, and is shifted back afterwards
+    _tileShapes.resize(_tileShapeStart[tileCount]);
+    for (int i = 0; i < scene.count; ++i)
+    {
+        const glm::ivec4& tiles = _shapeTiles[i];
+        for (int ty = tiles.y; ty <= tiles.w; ++ty)
+        {
+            for (int tx = tiles.x; tx <= tiles.z; ++tx)
+            {
+                _tileShapes[_tileShapeStart[ty * tilesX + tx]++] = i;
+            }
+        }
+    }
+
+    for (int tile = tileCount; tile > 0; --tile)
+    {
+        _tileShapeStart[tile] = _tileShapeStart[tile - 1];
+    }
+    _tileShapeStart[0] = 0;
+}
+
+bool RayMarchingManager::projectSphere(const glm::vec3& center, float radius, glm::vec2& pixelMin, glm::vec2& pixelMax) const
+{
+    // Rows of the inverse of createCameraRay: the pixel of a point is at (u, v) / w
+    const glm::mat3 rows = glm::transpose(getDirectionToUV());
+    const glm::vec3 offset = center - _rayOrigin;
+    const float w = glm::dot(rows[2], offset);
+    const float wLength = glm::length(rows[2]);
+    const float radiusSq = radius * radius;
+
+    // Behind the plane of the camera
+    if (w < -radius * wLength)
+    {
+        return false;
+    }
+
+    // Across that plane, the projection is unbounded
+    if (w <= radius * wLength)
+    {
+        pixelMin = glm::vec2(-std::numeric_limits<float>::max());
+        pixelMax = glm::vec2(std::numeric_limits<float>::max());
+        return true;
+    }
+
+    // The planes through the camera tangent to the sphere, (row - x rows[2]) . offset = +-radius |row - x rows[2]|,
+    // are the roots of a quadratic in x
+    float low[2], high[2];
+    const float a = w * w - radiusSq * wLength * wLength;
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        const glm::vec3& row = rows[axis];
+        const float d = glm::dot(row, offset);
+        const float b = d * w - radiusSq * glm::dot(row, rows[2]);
+        const float c = d * d - radiusSq * glm::dot(row, row);
+        const float root = std::sqrt(std::max(b * b - a * c, 0.0f));
+        low[axis] = (b - root) / a;
+        high[axis] = (b + root) / a;
+    }
+
+    const glm::vec2 size((float)_renderWidth, (float)_renderHeight);
+    pixelMin = (glm::vec2(low[0], low[1]) + 1.0f) * 0.5f * size;
+    pixelMax = (glm::vec2(high[0], high[1]) + 1.0f) * 0.5f * size;
+    return true;
+}
+
+int RayMarchingManager::nearestShape(const SceneRun& run, const glm::vec3& p, int& closest, float& closestDst) const
+{
+    using namespace simd;
+
+    const SceneData& scene = _scene;
+
+    const floatv px = p.x, py = p.y, pz = p.z;
+    floatv bestDst = std::numeric_limits<float>::max();
+    floatv bestIndex = -1.0f;
+    floatv index = laneIndex() + floatv((float)run.begin);
+
+    int i = run.begin;
+    if (run.end - run.begin < LANES)
+    {
+        closest = -1;
+        return i;
+    }
+
+    for (; i + LANES <= run.end; i += LANES)
+    {
+        floatv dx = floatv::loadu(&scene.x[i]) - px;
+        floatv dy = floatv::loadu(&scene.y[i]) - py;
+        floatv dz = floatv::loadu(&scene.z[i]) - pz;
+        floatv dst = sqrt(dx * dx + dy * dy + dz * dz) - floatv::loadu(&scene.radius[i]);
+
+        // Strict comparison keeps the first shape of each lane on ties, like the sequential fold
+        floatv closer = dst < bestDst;
+        bestDst = select(closer, dst, bestDst);
+        bestIndex = select(closer, index, bestIndex);
+        index = index + floatv((float)LANES);
+    }
+
+    alignas(32) float laneDst[LANES], laneShapes[LANES];
+    bestDst.store(laneDst);
+    bestIndex.store(laneShapes);
+
+    closest = -1;
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        int laneShape = (int)laneShapes[lane];
+        if (laneShape < 0)
+        {
+            continue;
+        }
+
+        if (closest < 0 || laneDst[lane] < closestDst || (laneDst[lane] == closestDst && laneShape < closest))
+        {
+            closest = laneShape;
+            closestDst = laneDst[lane];
+        }
+    }
+
+    return i;
+}
+
+void RayMarchingManager::getSceneInfoPacket(const simd::floatv& x, const simd::floatv& y, const simd::floatv& z,
+    simd::floatv& dst, simd::floatv& r, simd::floatv& g, simd::floatv& b, const ShapeList* shapes,
+    simd::floatv* bounds, const simd::floatv& rayDst, int active)
+{
+    using namespace simd;
+
+    const SceneData& scene = _scene;
+
+    floatv globalDst = _settings.maxDst;
+    floatv globalR = 1.0f, globalG = 1.0f, globalB = 1.0f;
+
+    const int count = shapes ? shapes->count : scene.count;
+    for (int first = 0; first < count; first += LANES) {
+        const int last = std::min(first + LANES, count);
+        for (int needed = neededShapes(bounds, shapes, first, last, rayDst, globalDst, active); needed; needed &= needed - 1) {
+            const int i = shapeIndex(shapes, first + firstLane(needed));
+            floatv dx = x - scene.x[i];
+            floatv dy = y - scene.y[i];
+            floatv dz = z - scene.z[i];
+            floatv localDst = sqrt(dx * dx + dy * dy + dz * dz) - scene.radius[i];
+            if (bounds)
+                bounds[i] = localDst + rayDst;
+
+            if (scene.operation[i] == EOperation::BLEND)
+            {
+                // Same as Blend(globalDst, localDst, ...)
+                floatv k = scene.blendStrength[i];
+                floatv h = min(max(floatv(0.5f) + floatv(0.5f) * (localDst - globalDst) / k, 0.0f), 1.0f);
+                floatv oneMinusH = floatv(1.0f) - h;
+                globalDst = localDst * oneMinusH + globalDst * h - k * h * oneMinusH;
+                globalR = floatv(scene.colorR[i]) * oneMinusH + globalR * h;
+                globalG = floatv(scene.colorG[i]) * oneMinusH + globalG * h;
+                globalB = floatv(scene.colorB[i]) * oneMinusH + globalB * h;
+            }
+            else
+            {
+                floatv closer = localDst < globalDst;
+                globalDst = select(closer, localDst, globalDst);
+                globalR = select(closer, scene.colorR[i], globalR);
+                globalG = select(closer, scene.colorG[i], globalG);
+                globalB = select(closer, scene.colorB[i], globalB);
+            }
+        }
+    }
+
+    dst = globalDst;
+    r = globalR;
+    g = globalG;
+    b = globalB;
+}
+
+void RayMarchingManager::getSceneDistancePacket(const simd::floatv& x, const simd::floatv& y, const simd::floatv& z,
+    simd::floatv& dst, const ShapeList* shapes, simd::floatv* bounds, const simd::floatv& rayDst, int active)
+{
+    using namespace simd;
+
+    const SceneData& scene = _scene;
+
+    floatv globalDst = _settings.maxDst;
+
+    const int count = shapes ? shapes->count : scene.count;
+    for (int first = 0; first < count; first += LANES) {
+        const int last = std::min(first + LANES, count);
+        for (int needed = neededShapes(bounds, shapes, first, last, rayDst, globalDst, active); needed; needed &= needed - 1) {
+            const int i = shapeIndex(shapes, first + firstLane(needed));
+            floatv dx = x - scene.x[i];
+            floatv dy = y - scene.y[i];
+            floatv dz = z - scene.z[i];
+            floatv localDst = sqrt(dx * dx + dy * dy + dz * dz) - scene.radius[i];
+            if (bounds)
+                bounds[i] = localDst + rayDst;
+
+            if (scene.operation[i] == EOperation::BLEND)
+            {
+                floatv k = scene.blendStrength[i];
+                floatv h = min(max(floatv(0.5f) + floatv(0.5f) * (localDst - globalDst) / k, 0.0f), 1.0f);
+                floatv oneMinusH = floatv(1.0f) - h;
+                globalDst = localDst * oneMinusH + globalDst * h - k * h * oneMinusH;
+            }
+            else
+            {
+                globalDst = select(localDst < globalDst, localDst, globalDst);
+            }
+        }
+    }
+
+    dst = globalDst;
+}
+
+int RayMarchingManager::neededShapes(const simd::floatv* bounds, const ShapeList* shapes, int first, int last, const simd::floatv& rayDst,
+    const simd::floatv& globalDst, int active) const
+{
+    using namespace simd;
+
+    if (!bounds)
+    {
+        return (1 << (last - first)) - 1;
+    }
+
+    // A shape is needed as soon as one active lane needs it
+    const floatv limit = globalDst + rayDst + floatv(RAY_BOUNDS_MARGIN * _settings.epsilon);
+    int needed = 0;
+    for (int c = first; c < last; ++c)
+    {
+        const int i = shapeIndex(shapes, c);
+        needed |= (movemask(bounds[i] < limit + floatv(_scene.reach[i])) & active) ? 1 << (c - first) : 0;
+    }
+    return needed;
+}
+
+void RayMarchingManager::resetRayBounds(simd::floatv* bounds) const
+{
+    std::fill(bounds, bounds + _scene.count, simd::floatv(-std::numeric_limits<float>::infinity()));
+}
+
+glm::vec3 RayMarchingManager::estimateNormal(const glm::vec3& p, int* shape)
+{
+    if (_settings.normalMode == ENormalMode::ANALYTIC)
+    {
+        return normalize(glm::vec3(getSceneGradient(p, shape)));
+    }
+
+    // The other modes only evaluate distances, the gradient pass finds the shape
+    if (shape)
+    {
+        getSceneGradient(p, shape);
+    }
+
+    switch (_settings.normalMode)
+    {
+    case ENormalMode::TETRAHEDRON:
+        return estimateNormalTetrahedron(p);
+    default:
+        return estimateNormalCentral(p);
+    }
+}
+
+glm::vec3 RayMarchingManager::estimateNormalCentral(const glm::vec3& p)
+{
+    float x = getSceneDistance(glm::vec3(p.x + _settings.epsilon, p.y, p.z)) - getSceneDistance(glm::vec3(p.x - _settings.epsilon, p.y, p.z));
+    float y = getSceneDistance(glm::vec3(p.x, p.y + _settings.epsilon, p.z)) - getSceneDistance(glm::vec3(p.x, p.y - _settings.epsilon, p.z));
+    float z = getSceneDistance(glm::vec3(p.x, p.y, p.z + _settings.epsilon)) - getSceneDistance(glm::vec3(p.x, p.y, p.z - _settings.epsilon));
+    return normalize(glm::vec3(x, y, z));
+}
+
+// Tetrahedron technique
+// from https://iquilezles.org/articles/normalsSDF/
+glm::vec3 RayMarchingManager::estimateNormalTetrahedron(const glm::vec3& p)
+{
+    const float h = _settings.epsilon;
+    const glm::vec3 k0(1, -1, -1), k1(-1, -1, 1), k2(-1, 1, -1), k3(1, 1, 1);
+    return normalize(k0 * getSceneDistance(p + k0 * h)
+        + k1 * getSceneDistance(p + k1 * h)
+        + k2 * getSceneDistance(p + k2 * h)
+        + k3 * getSceneDistance(p + k3 * h));
+}
+
+glm::vec4 RayMarchingManager::getSceneGradient(const glm::vec3& p, int* shape)
+{
+    const SceneData& scene = _scene;
+
+    float globalDst = _settings.maxDst;
+    glm::vec3 globalGradient = glm::vec3(0);
+
+    // Blended shapes share the surface, the closest one is the shape of the point
+    int closest = -1;
+    float closestDst = std::numeric_limits<float>::max();
+
+    int candidates[BVH_MAX_CANDIDATES];
+    int candidateCount = gatherShapes(p, candidates);
+    const bool allShapes = candidateCount < 0;
+    if (allShapes)
+    {
+        candidateCount = scene.count;
+    }
+
+    for (int c = 0; c < candidateCount; c++) {
+        const int i = allShapes ? c : candidates[c];
+        // Sphere: distance |p - c| - r, gradient (p - c) / |p - c|
+        glm::vec3 offset = p - glm::vec3(scene.x[i], scene.y[i], scene.z[i]);
+        float length = glm::length(offset);
+        float localDst = length - scene.radius[i];
+        glm::vec3 localGradient = length > 0.0f ? offset / length : glm::vec3(0);
+
+        if (localDst < closestDst)
+        {
+            closest = i;
+            closestDst = localDst;
+        }
+
+        if (scene.operation[i] == EOperation::BLEND)
+        {
+            // The derivative of the smooth min with respect to h vanishes,
+            // the gradient is the same mix as the distances
+            float k = scene.blendStrength[i];
+            float h = saturate(0.5f + 0.5f * (localDst - globalDst) / k);
+            globalDst = lerp(localDst, globalDst, h) - k * h * (1.0f - h);
+            globalGradient = lerp(localGradient, globalGradient, h);
+        }
+        else if (localDst < globalDst)
+        {
+            globalDst = localDst;
+            globalGradient = localGradient;
+        }
+    }
+
+    if (shape)
+    {
+        *shape = closest;
+    }
+    return glm::vec4(globalGradient, globalDst);
+}
+
+
+void RayMarchingManager::update()
+{
+    if (beginFrame())
+    {
+        endFrame(renderFrame());
+    }
+}
+
+bool RayMarchingManager::beginFrame()
+{
+    applyChanges();
+
+    if (!_settings.dynamicResolution && _renderScale != 1.0f)
+    {
+        setRenderScale(1.0f);
+    }
+
+    if (currentSample == maxSamples && !_shadingFrame)
+    {
+        return false;
+    }
+
+    _frameStart = std::chrono::steady_clock::now();
+
+    // Sub-pixel position of this sample, shared by every pixel. The first sample is unshifted
+    _sampleOffset = glm::vec2(halton(currentSample, 2), halton(currentSample, 3));
+
+    // Interactive frames march one pixel in two, alternating each frame. Such a frame is only half of the
+    // first sample: when the view stays still, the next frame marches the other half before the samples go on
+    _checkerboardFrame = currentSample == 0 && (_checkerboardHalf || (_settings.checkerboard && _renderBufferValid));
+    if (_checkerboardFrame)
+    {
+        _checkerboardParity ^= 1;
+    }
+
+    return true;
+}
+
+RayMarchingStats RayMarchingManager::renderFrame()
+{
+    if (_shadingFrame)
+    {
+        shadeGBuffer();
+        upscale();
+        return RayMarchingStats();
+    }
+
+    std::atomic<long long> totalSteps{ 0 };
+    std::atomic<long long> totalRays{ 0 };
+
+    const int tilesX = (_renderWidth + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (_renderHeight + TILE_SIZE - 1) / TILE_SIZE;
+
+    // With the BVH a scalar ray visits a few shapes, a packet would visit all of them
+    const bool packets = _settings.usePackets && !useBVH();
+
+    // Analytic rays need no start distance, neither reprojected nor from the cones
+    const bool analytic = useAnalyticSpheres();
+
+    const bool binned = useTileBinning();
+    if (binned)
+    {
+        binShapes(tilesX, tilesY);
+    }
+
+    const bool reproject = !analytic && currentSample == 0 && _reprojectionPending && _settings.reprojection;
+    if (reproject)
+    {
+        reprojectHits();
+    }
+
+    _threadPool.parallelFor(tilesX * tilesY, [&](int tile)
+    {
+        const int x0 = (tile % tilesX) * TILE_SIZE;
+        const int y0 = (tile / tilesX) * TILE_SIZE;
+        const int x1 = std::min(x0 + TILE_SIZE, _renderWidth);
+        const int y1 = std::min(y0 + TILE_SIZE, _renderHeight);
+
+        long long tileSteps = 0;
+        long long tileRays = 0;
+
+        // Converged tiles are skipped entirely, cones included
+        bool tileNeedsSample = false;
+        for (int y = y0; y < y1 && !tileNeedsSample; ++y)
+        {
+            for (int x = x0; x < x1 && !tileNeedsSample; ++x)
+            {
+                tileNeedsSample = needsSample(x, y);
+            }
+        }
+        if (!tileNeedsSample)
+        {
+            return;
+        }
+
+        // A list of every shape is folded without it, single rays then evaluate the union runs with SIMD
+        ShapeList tileShapes = { nullptr, 0 };
+        const ShapeList* shapes = nullptr;
+        if (binned)
+        {
+            tileShapes = getTileShapes(tile);
+            shapes = tileShapes.count < _scene.count ? &tileShapes : nullptr;
+        }
+        const bool traced = analytic || (binned && useAnalyticSpheres(&tileShapes));
+
+        const int blocks = TILE_SIZE / CONE_MIN_SIZE;
+        float startDst[blocks * blocks] = {};
+
+        // The cones are not needed when the whole tile is covered by the reprojection
+        bool reprojected = reproject && !traced;
+        for (int by = y0; by < y1 && reproject && !traced; by += CONE_MIN_SIZE)
+        {
+            for (int bx = x0; bx < x1; bx += CONE_MIN_SIZE)
+            {
+                float& block = startDst[(by - y0) / CONE_MIN_SIZE * blocks + (bx - x0) / CONE_MIN_SIZE];
+                block = getReprojectedStart(bx, by);
+                reprojected &= block > 0.0f;
+            }
+        }
+
+        if (_settings.coneMarching && !reprojected && !traced)
+        {
+            float coneDst[blocks * blocks] = {};
+            tileSteps += marchCones(x0, y0, x1, y1, packets, coneDst, shapes);
+            for (int i = 0; i < blocks * blocks; ++i)
+            {
+                startDst[i] = std::max(startDst[i], coneDst[i]);
+            }
+        }
+        auto blockStart = [&](int x, int y) { return startDst[(y - y0) / CONE_MIN_SIZE * blocks + (x - x0) / CONE_MIN_SIZE]; };
+
+        for (int y = y0; y < y1; ++y)
+        {
+            if (packets)
+            {
+                // Checkerboard packets take every other pixel of the row
+                const int stride = _checkerboardFrame ? 2 : 1;
+                const int xStart = x0 + (_checkerboardFrame && !needsSample(x0, y));
+                for (int x = xStart; x < x1; x += simd::LANES * stride)
+                {
+                    // Like single rays, only the pixels needing a sample are marched and accumulated
+                    const int count = std::min(simd::LANES, (x1 - x + stride - 1) / stride);
+                    int lanes = 0;
+                    float laneStart[simd::LANES];
+                    for (int lane = 0; lane < simd::LANES; ++lane)
+                    {
+                        laneStart[lane] = blockStart(x + (lane < count ? lane : 0) * stride, y);
+                        if (lane < count && needsSample(x + lane * stride, y))
+                        {
+                            lanes |= 1 << lane;
+                        }
+                    }
+                    if (lanes)
+                    {
+                        tileSteps += traced
+                            ? tracePacket(x, y, lanes, stride, shapes)
+                            : marchPacket(x, y, lanes, stride, laneStart, shapes);
+                        tileRays += simd::countLanes(lanes);
+                    }
+                }
+            }
+            else
+            {
+                for (int x = x0; x < x1; ++x)
+                {
+                    if (needsSample(x, y))
+                    {
+                        tileSteps += traced ? tracePixel(x, y, shapes) : marchPixel(x, y, blockStart(x, y), shapes);
+                        tileRays++;
+                    }
+                }
+            }
+        }
+        totalRays += tileRays;
+        totalSteps += tileSteps;
+    });
+
+    if (_checkerboardFrame && !_checkerboardHalf)
+    {
+        reconstructCheckerboard();
+    }
+
+    upscale();
+
+    RayMarchingStats stats;
+    stats.rays = totalRays;
+    stats.marchSteps = totalSteps;
+    return stats;
+}
+
+void RayMarchingManager::endFrame(const RayMarchingStats& stats)
+{
+    _stats = stats;
+    _renderBufferValid = true;
+
+    // The other half of the first sample, and of the ray cache, is left to the next frame
+    const bool halfFrame = _checkerboardFrame && !_checkerboardHalf;
+
+    // Only the first sample marches every pixel, the next ones skip the converged pixels and march
+    // shifted rays: their duration says nothing about the cost of an interactive frame
+    const bool firstSample = currentSample == 0 && !(_checkerboardFrame && _checkerboardHalf);
+    if (currentSample == 0)
+    {
+        _needToUpdateRays = _needToUpdateRays && halfFrame;
+        _hitPointsValid = true;
+        _reprojectionPending = false;
+    }
+
+    // The shading pass gave every pixel its first sample again
+    const bool shadingFrame = _shadingFrame;
+    if (shadingFrame)
+    {
+        currentSample = 1;
+        _partialSamples = false;
+        _shadingFrame = false;
+    }
+    else if (halfFrame)
+    {
+        _checkerboardHalf = true;
+    }
+    else
+    {
+        _checkerboardHalf = false;
+
+        // Every pixel converged, the image is final. Kept pixels may still need samples further on
+        currentSample = stats.rays > 0 || _partialSamples ? currentSample + 1 : maxSamples;
+    }
+
+    if (_output)
+    {
+        _output->present(_buffer, _width, _height);
+    }
+
+    // Nor does a partial frame or a shading pass. A still view accumulating its samples is never restarted
+    if (_settings.dynamicResolution && firstSample && !_partialSamples && !shadingFrame)
+    {
+        updateRenderScale(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - _frameStart).count());
+    }
+}
+
+void RayMarchingManager::reconstructCheckerboard()
+{
+    // Skipped pixels still hold their color of the previous frame. It is clamped to the range of
+    // the pair of marched neighbours (left-right or down-up) that differ the least, i.e. along an
+    // edge rather than across it, so stale colors of a moving edge do not leak through
+    const float tolerance = 4.0f;
+    const int rowBlocks = (_regionY1 - _regionY0 + TILE_SIZE - 1) / TILE_SIZE;
+    _threadPool.parallelFor(rowBlocks, [&](int block)
+    {
+        auto neighbour = [&](int x, int y) {
+            const unsigned char* color = &_renderBuffer[(glm::clamp(y, 0, _renderHeight - 1) * _renderWidth + glm::clamp(x, 0, _renderWidth - 1)) * 3];
+            return glm::vec3(color[0], color[1], color[2]);
+        };
+
+        const int yStart = _regionY0 + block * TILE_SIZE;
+        for (int y = yStart; y < std::min(yStart + TILE_SIZE, _regionY1); ++y)
+        {
+            for (int x = _regionX0 + ((_regionX0 + y + _checkerboardParity + 1) & 1); x < _regionX1; x += 2)
+            {
+                const int pixelID = y * _renderWidth + x;
+
+                // No sample yet, the next pass starts its mean
+                _sampleCount[pixelID] = 0;
+                _converged[pixelID] = false;
+                _hasHit[pixelID] = false;
+
+                // Out of the image the other neighbour of the pair stands in
+                glm::vec3 left = neighbour(x - 1, y), right = neighbour(x + 1, y);
+                glm::vec3 down = neighbour(x, y - 1), up = neighbour(x, y + 1);
+                if (x == 0) left = right;
+                if (x == _renderWidth - 1) right = left;
+                if (y == 0) down = up;
+                if (y == _renderHeight - 1) up = down;
+
+                const glm::vec3 horizontal = glm::abs(left - right);
+                const glm::vec3 vertical = glm::abs(down - up);
+                const bool useHorizontal = horizontal.r + horizontal.g + horizontal.b <= vertical.r + vertical.g + vertical.b;
+                const glm::vec3 low = useHorizontal ? glm::min(left, right) : glm::min(down, up);
+                const glm::vec3 high = useHorizontal ? glm::max(left, right) : glm::max(down, up);
+
+                unsigned char* color = &_renderBuffer[pixelID * 3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    color[c] = (unsigned char)glm::clamp((float)color[c], std::max(low[c] - tolerance, 0.0f), std::min(high[c] + tolerance, 255.0f));
+                }
+            }
+        }
+    });
+}
+
+glm::mat3 RayMarchingManager::getDirectionToUV() const
+{
+    // Directions are cameraToWorld * (inverseProjection * (uv, 0, 1))
+    const glm::mat4& inverseProjection = _camera.getCameraInverseProjection();
+    const glm::mat3 uvToDirection = glm::mat3(_camera.getCameraToWorld())
+        * glm::mat3(glm::vec3(inverseProjection[0]), glm::vec3(inverseProjection[1]), glm::vec3(inverseProjection[3]));
+    return glm::inverse(uvToDirection);
+}
+
+void RayMarchingManager::applyShapeChanges()
+{
+    // A shape changes the scene within its sphere grown by its blend strength, by the distance the
+    // BVH keeps for chains of blends, and by epsilon since hits are accepted that far from a surface
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    auto shapeBounds = [&](float margin) {
+        for (int index : _changedShapes)
+        {
+            const glm::vec3 position(_scene.x[index], _scene.y[index], _scene.z[index]);
+            float reach = _scene.radius[index] + margin + _settings.epsilon;
+            if (_scene.operation[index] == EOperation::BLEND)
+            {
+                reach += _scene.blendStrength[index];
+            }
+            boundsMin = glm::min(boundsMin, position - reach);
+            boundsMax = glm::max(boundsMax, position + reach);
+        }
+    };
+
+    // Added or removed shapes: the whole image
+    const int previousCount = _scene.count;
+    const bool known = std::all_of(_changedShapes.begin(), _changedShapes.end(),
+        [&](int index) { return index >= 0 && index < previousCount; });
+    const float previousMargin = _bvh.getBlendMargin();
+    if (known)
+    {
+        shapeBounds(previousMargin);
+    }
+
+    _scene.build(_editSettings.shapes, _editSettings.numShapes);
+    buildBVH();
+    _reprojectionPending = false;
+
+    if (!known || _scene.count != previousCount)
+    {
+        restartSamples();
+        _hitPointsValid = false;
+        return;
+    }
+    shapeBounds(std::max(previousMargin, _bvh.getBlendMargin()));
+
+    // Pixels covered by the projection of the box corners, the whole image if a corner is behind the camera
+    const glm::mat3 directionToUV = getDirectionToUV();
+    glm::vec2 pixelMin(std::numeric_limits<float>::max());
+    glm::vec2 pixelMax(-std::numeric_limits<float>::max());
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const glm::vec3 p((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y, (corner & 4) ? boundsMax.z : boundsMin.z);
+        const glm::vec3 uv = directionToUV * (p - _rayOrigin);
+        if (uv.z <= 0.0f)
+        {
+            pixelMin = glm::vec2(-std::numeric_limits<float>::max());
+            pixelMax = glm::vec2(std::numeric_limits<float>::max());
+            break;
+        }
+        const glm::vec2 pixel = (glm::vec2(uv) / uv.z + 1.0f) * 0.5f * glm::vec2(_renderWidth, _renderHeight);
+        pixelMin = glm::min(pixelMin, pixel);
+        pixelMax = glm::max(pixelMax, pixel);
+    }
+
+    // One pixel more on each side for the sub-pixel offsets of the samples
+    const int x0 = (int)glm::clamp(std::floor(pixelMin.x) - 1.0f, 0.0f, (float)_renderWidth);
+    const int y0 = (int)glm::clamp(std::floor(pixelMin.y) - 1.0f, 0.0f, (float)_renderHeight);
+    const int x1 = (int)glm::clamp(std::ceil(pixelMax.x) + 2.0f, 0.0f, (float)_renderWidth);
+    const int y1 = (int)glm::clamp(std::ceil(pixelMax.y) + 2.0f, 0.0f, (float)_renderHeight);
+    if (x0 >= x1 || y0 >= y1)
+    {
+        return;
+    }
+
+    // The first sample has not run yet since the last restart: it must also cover the pending region
+    if (currentSample == 0)
+    {
+        _regionX0 = std::min(_regionX0, x0);
+        _regionY0 = std::min(_regionY0, y0);
+        _regionX1 = std::max(_regionX1, x1);
+        _regionY1 = std::max(_regionY1, y1);
+    }
+    else
+    {
+        _regionX0 = x0;
+        _regionY0 = y0;
+        _regionX1 = x1;
+        _regionY1 = y1;
+    }
+    currentSample = 0;
+
+    // The pending checkerboard half would skip the changed pixels of the other parity
+    _checkerboardHalf = false;
+    _partialSamples = _regionX0 > 0 || _regionY0 > 0 || _regionX1 < _renderWidth || _regionY1 < _renderHeight;
+}
+
+void RayMarchingManager::applySamplingChange()
+{
+    // Pixels without samples are sampled anyway
+    int fewestSamples = currentSample;
+    for (int pixelID = 0; pixelID < _renderPixels; ++pixelID)
+    {
+        const int samples = _sampleCount[pixelID];
+        if (samples == 0)
+        {
+            continue;
+        }
+
+        const glm::vec3 sum(_accumulation[pixelID * 3], _accumulation[pixelID * 3 + 1], _accumulation[pixelID * 3 + 2]);
+        _converged[pixelID] = isConverged(sum, _luminanceSq[pixelID], samples);
+        if (!_converged[pixelID])
+        {
+            fewestSamples = std::min(fewestSamples, samples);
+        }
+    }
+
+    // Like the pixels kept by UpdateShape(), the others wait for currentSample to catch up
+    if (currentSample > 0 && fewestSamples < currentSample)
+    {
+        currentSample = fewestSamples;
+        _partialSamples = true;
+    }
+}
+
+void RayMarchingManager::reprojectHits()
+{
+    // Inverse of createCameraRay
+    const glm::mat3 directionToUV = getDirectionToUV();
+
+    std::fill(_reprojectedDst.begin(), _reprojectedDst.end(), std::numeric_limits<float>::max());
+
+    for (int pixelID = 0; pixelID < _renderPixels; ++pixelID)
+    {
+        if (!_hasHit[pixelID])
+        {
+            continue;
+        }
+
+        const glm::vec3 offset = _hitPoints[pixelID] - _rayOrigin;
+        const glm::vec3 uv = directionToUV * offset;
+        if (uv.z <= 0.0f)
+        {
+            continue;
+        }
+
+        const float x = (uv.x / uv.z + 1.0f) * 0.5f * _renderWidth;
+        const float y = (uv.y / uv.z + 1.0f) * 0.5f * _renderHeight;
+        if (!(x > -1.0f && x < _renderWidth && y > -1.0f && y < _renderHeight))
+        {
+            continue;
+        }
+
+        // Write the 2x2 pixels around the point so that small zooms leave no holes
+        const float dst = glm::length(offset);
+        const int px = (int)std::floor(x);
+        const int py = (int)std::floor(y);
+        for (int j = std::max(py, 0); j <= std::min(py + 1, _renderHeight - 1); ++j)
+        {
+            for (int i = std::max(px, 0); i <= std::min(px + 1, _renderWidth - 1); ++i)
+            {
+                float& reprojected = _reprojectedDst[j * _renderWidth + i];
+                reprojected = std::min(reprojected, dst);
+            }
+        }
+    }
+}
+
+float RayMarchingManager::getReprojectedStart(int x, int y) const
+{
+    // The block and a ring of one pixel around it, surfaces seen only by a neighbour may be
+    // in front of the block's rays
+    float minDst = std::numeric_limits<float>::max();
+    float maxDst = 0.0f;
+    for (int j = std::max(y - 1, 0); j <= std::min(y + CONE_MIN_SIZE, _renderHeight - 1); ++j)
+    {
+        for (int i = std::max(x - 1, 0); i <= std::min(x + CONE_MIN_SIZE, _renderWidth - 1); ++i)
+        {
+            // A pixel without hit may see anything, e.g. a shape entering the view
+            const float reprojected = _reprojectedDst[j * _renderWidth + i];
+            if (reprojected == std::numeric_limits<float>::max())
+            {
+                return 0.0f;
+            }
+            minDst = std::min(minDst, reprojected);
+            maxDst = std::max(maxDst, reprojected);
+        }
+    }
+
+    // Depth discontinuity: a silhouette, where disoccluded surfaces can appear
+    if (maxDst - minDst > REPROJECTION_MAX_RANGE * _settings.reprojectionMargin)
+    {
+        return 0.0f;
+    }
+    return std::max(minDst - _settings.reprojectionMargin, 0.0f);
+}
+
+int RayMarchingManager::marchCones(int x0, int y0, int x1, int y1, bool packets, float* startDst, const ShapeList* shapes)
+{
+    const int blocks = TILE_SIZE / CONE_MIN_SIZE;
+    int marchSteps = 0;
+
+    // Each level starts from the distance found by the enclosing cone
+    for (int size = CONE_MAX_SIZE; size >= CONE_MIN_SIZE; size /= 2)
+    {
+        glm::vec3 axis[blocks * blocks];
+        float spread[blocks * blocks];
+        float coneDst[blocks * blocks];
+        int blockID[blocks * blocks];
+
+        int count = 0;
+        for (int by = y0; by < y1; by += size)
+        {
+            for (int bx = x0; bx < x1; bx += size)
+            {
+                getPixelCone(bx, by, std::min(bx + size, x1), std::min(by + size, y1), axis[count], spread[count]);
+                blockID[count] = (by - y0) / CONE_MIN_SIZE * blocks + (bx - x0) / CONE_MIN_SIZE;
+                coneDst[count] = startDst[blockID[count]];
+                count++;
+            }
+        }
+
+        for (int i = 0; i < count; i += packets ? simd::LANES : 1)
+        {
+            marchSteps += packets
+                ? marchConePacket(&axis[i], &spread[i], &coneDst[i], std::min(simd::LANES, count - i), shapes)
+                : marchCone(axis[i], spread[i], coneDst[i], shapes);
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            for (int y = 0; y < size / CONE_MIN_SIZE; ++y)
+            {
+                for (int x = 0; x < size / CONE_MIN_SIZE; ++x)
+                {
+                    startDst[blockID[i] + y * blocks + x] = coneDst[i];
+                }
+            }
+        }
+    }
+
+    return marchSteps;
+}
+
+void RayMarchingManager::getPixelCone(int x0, int y0, int x1, int y1, glm::vec3& axis, float& spread)
+{
+    auto pixelDirection = [&](int x, int y) {
+        return createCameraRay(getPixelUV((float)x, (float)y)).direction;
+    };
+
+    const glm::vec3 corners[4] = {
+        pixelDirection(x0, y0), pixelDirection(x1 - 1, y0),
+        pixelDirection(x0, y1 - 1), pixelDirection(x1 - 1, y1 - 1)
+    };
+    axis = normalize(corners[0] + corners[1] + corners[2] + corners[3]);
+
+    // At distance t the point of any ray of the block is within t * spread of the axis,
+    // so a ball of radius dst on the axis leaves dst - t * spread free along every ray
+    spread = 0.0f;
+    for (const glm::vec3& corner : corners)
+    {
+        spread = std::max(spread, glm::length(corner - axis));
+    }
+}
+
+int RayMarchingManager::marchCone(const glm::vec3& axis, float spread, float& coneDst, const ShapeList* shapes)
+{
+    int marchSteps = 0;
+
+    // Same distance convention as the pixel march, which starts at rayDst = 1
+    while (1 + coneDst < _settings.maxDst)
+    {
+        marchSteps++;
+        const float freeDst = getSceneDistance(Ray(_rayOrigin + axis * coneDst), shapes) - coneDst * spread;
+        if (freeDst < _settings.epsilon)
+        {
+            break;
+        }
+        coneDst += freeDst;
+    }
+
+    return marchSteps;
+}
+
+int RayMarchingManager::marchConePacket(const glm::vec3* axis, const float* spread, float* coneDst, int count, const ShapeList* shapes)
+{
+    using namespace simd;
+
+    alignas(32) float axisX[LANES], axisY[LANES], axisZ[LANES], laneSpread[LANES], laneDst[LANES];
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        const int i = lane < count ? lane : 0;
+        axisX[lane] = axis[i].x;
+        axisY[lane] = axis[i].y;
+        axisZ[lane] = axis[i].z;
+        laneSpread[lane] = spread[i];
+        laneDst[lane] = coneDst[i];
+    }
+
+    const floatv ax = floatv::load(axisX), ay = floatv::load(axisY), az = floatv::load(axisZ);
+    const floatv spreadv = floatv::load(laneSpread);
+    const floatv maxDst = _settings.maxDst - 1.0f;
+    const floatv epsilon = _settings.epsilon;
+    floatv dstv = floatv::load(laneDst);
+
+    // Stopped lanes are not evaluated anymore (the bounds skip the shapes they need), they are frozen
+    floatv running = dstv < maxDst;
+    int active = ((1 << count) - 1) & movemask(running);
+    int marchSteps = 0;
+
+    floatv shapeBounds[RAY_BOUNDS_MAX_SHAPES];
+    floatv* bounds = useRayBounds() ? shapeBounds : nullptr;
+    if (bounds)
+    {
+        resetRayBounds(bounds);
+    }
+
+    while (active)
+    {
+        marchSteps += countLanes(active);
+
+        floatv dst;
+        getSceneDistancePacket(floatv(_rayOrigin.x) + ax * dstv, floatv(_rayOrigin.y) + ay * dstv, floatv(_rayOrigin.z) + az * dstv, dst,
+            shapes, bounds, dstv, active);
+
+        const floatv freeDst = dst - dstv * spreadv;
+        running = running & (epsilon <= freeDst);
+        dstv = dstv + select(running, freeDst, 0.0f);
+        running = running & (dstv < maxDst);
+        active &= movemask(running);
+    }
+
+    dstv.store(laneDst);
+    for (int lane = 0; lane < count; ++lane)
+    {
+        coneDst[lane] = laneDst[lane];
+    }
+
+    return marchSteps;
+}
+
+int RayMarchingManager::marchPixel(int x, int y, float startDst, const ShapeList* shapes)
+{
+    const int bufferID = (y * _renderWidth + x) * 3;
+
+    bool hit = false;
+    int marchSteps = 0;
+
+    Ray ray = getPixelRay(x, y);
+
+    // Only march the part of the ray inside the scene bounds
+    float enterDst, exitDst;
+    if (!clipRay(ray.origin, ray.direction, enterDst, exitDst))
+    {
+        shadeBackground(bufferID);
+        return marchSteps;
+    }
+    startDst = std::max(startDst, enterDst);
+    const float endDst = std::min(_settings.maxDst, 1 + exitDst);
+
+    float rayDst = 1 + startDst;
+    ray.origin += ray.direction * startDst;
+    ray.org = { ray.origin.x, ray.origin.y, ray.origin.z };
+
+    // Over-relaxed sphere tracing, see RayMarchingSettings::overRelaxation
+    float omega = _settings.overRelaxation ? _settings.relaxationFactor : 1.0f;
+    float stepLength = 0.0f;
+    float previousDst = 0.0f;
+    float previousRayDst = rayDst;
+    glm::vec3 previousOrigin = ray.origin;
+
+    while (rayDst < endDst)
+    {
+        marchSteps++;
+        float dst = getSceneDistance(ray, shapes);
+
+        // The unbounding spheres do not overlap, the surface may have been skipped:
+        // go back to the previous point and continue with plain steps
+        if (omega > 1.0f && (dst < 0.0f || dst + previousDst < stepLength))
+        {
+            omega = 1.0f;
+            ray.origin = previousOrigin + ray.direction * previousDst;
+            ray.org = { ray.origin.x, ray.origin.y, ray.origin.z };
+            rayDst = previousRayDst + previousDst;
+            continue;
+        }
+
+        if (dst < _settings.epsilon)
+        {
+            // The color is only needed at the hit
+            shadePixel(bufferID, ray.origin, ray.direction, dst, getSceneInfo(ray, shapes));
+            hit = true;
+
+            break;
+        }
+
+        previousOrigin = ray.origin;
+        previousRayDst = rayDst;
+        previousDst = dst;
+        stepLength = dst * omega;
+
+        ray.origin += ray.direction * stepLength;
+        ray.org = { ray.origin.x, ray.origin.y, ray.origin.z };
+        rayDst += stepLength;
+    }
+
+    if (!hit)
+    {
+        shadeBackground(bufferID);
+    }
+
+    return marchSteps;
+}
+
+int RayMarchingManager::marchPacket(int x, int y, int lanes, int stride, const float* startDst, const ShapeList* shapes)
+{
+    using namespace simd;
+
+    alignas(32) float originX[LANES], originY[LANES], originZ[LANES];
+    alignas(32) float directionX[LANES], directionY[LANES], directionZ[LANES];
+    alignas(32) float laneStart[LANES], laneEnd[LANES];
+
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        // Unused lanes duplicate the first used one and stay masked out
+        const int i = (lanes & (1 << lane)) ? lane : firstLane(lanes);
+        Ray ray = getPixelRay(x + i * stride, y);
+        originX[lane] = ray.origin.x;
+        originY[lane] = ray.origin.y;
+        originZ[lane] = ray.origin.z;
+        directionX[lane] = ray.direction.x;
+        directionY[lane] = ray.direction.y;
+        directionZ[lane] = ray.direction.z;
+
+        // Lanes missing the scene bounds start inactive
+        float enterDst, exitDst;
+        const bool inside = clipRay(ray.origin, ray.direction, enterDst, exitDst);
+        laneStart[lane] = inside ? std::max(startDst[i], enterDst) : 0.0f;
+        laneEnd[lane] = inside ? std::min(_settings.maxDst, 1 + exitDst) : 0.0f;
+    }
+
+    const floatv start = floatv::load(laneStart);
+    const floatv dx = floatv::load(directionX), dy = floatv::load(directionY), dz = floatv::load(directionZ);
+    floatv ox = floatv::load(originX) + dx * start, oy = floatv::load(originY) + dy * start, oz = floatv::load(originZ) + dz * start;
+    const floatv endDst = floatv::load(laneEnd);
+    const floatv epsilon = _settings.epsilon;
+    const floatv zero = 0.0f, one = 1.0f;
+    floatv rayDst = one + start;
+
+    // Over-relaxation state, per lane as in marchPixel
+    floatv omega = _settings.overRelaxation ? _settings.relaxationFactor : 1.0f;
+    floatv stepLength = 0.0f;
+    floatv previousDst = 0.0f;
+    floatv previousRayDst = rayDst;
+    floatv px = ox, py = oy, pz = oz;
+
+    int active = lanes & movemask(rayDst < endDst);
+    int hits = 0;
+    int marchSteps = 0;
+
+    floatv shapeBounds[RAY_BOUNDS_MAX_SHAPES];
+    floatv* bounds = useRayBounds() ? shapeBounds : nullptr;
+    if (bounds)
+    {
+        resetRayBounds(bounds);
+    }
+
+    while (active)
+    {
+        marchSteps += countLanes(active);
+
+        // Unlike getSceneDistance(), the colors are off the dependency chain of the fold and cost
+        // next to nothing here, resolving them at the hits would cost an extra evaluation
+        floatv dst, r, g, b;
+        getSceneInfoPacket(ox, oy, oz, dst, r, g, b, shapes, bounds, rayDst, active);
+
+        const floatv failed = (one < omega) & ((dst < zero) | (dst + previousDst < stepLength));
+
+        // The bounds only hold moving forward
+        if (bounds && (movemask(failed) & active))
+        {
+            resetRayBounds(bounds);
+        }
+
+        const int newHits = active & ~movemask(failed) & movemask(dst < epsilon);
+        if (newHits)
+        {
+            alignas(32) float hitDst[LANES], hitR[LANES], hitG[LANES], hitB[LANES];
+            dst.store(hitDst); r.store(hitR); g.store(hitG); b.store(hitB);
+            ox.store(originX); oy.store(originY); oz.store(originZ);
+
+            for (int lane = 0; lane < LANES; ++lane)
+            {
+                if (newHits & (1 << lane))
+                {
+                    shadePixel((y * _renderWidth + x + lane * stride) * 3,
+                        glm::vec3(originX[lane], originY[lane], originZ[lane]),
+                        glm::vec3(directionX[lane], directionY[lane], directionZ[lane]),
+                        hitDst[lane], glm::vec3(hitR[lane], hitG[lane], hitB[lane]));
+                }
+            }
+
+            hits |= newHits;
+            active &= ~newHits;
+        }
+
+        // Failed lanes restart from their previous point with a plain step
+        px = select(failed, px, ox);
+        py = select(failed, py, oy);
+        pz = select(failed, pz, oz);
+        previousRayDst = select(failed, previousRayDst, rayDst);
+        previousDst = select(failed, previousDst, dst);
+        stepLength = select(failed, previousDst, dst * omega);
+        omega = select(failed, one, omega);
+
+        ox = px + dx * stepLength;
+        oy = py + dy * stepLength;
+        oz = pz + dz * stepLength;
+        rayDst = previousRayDst + stepLength;
+        active &= movemask(rayDst < endDst);
+    }
+
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        if (lanes & ~hits & (1 << lane))
+        {
+            shadeBackground((y * _renderWidth + x + lane * stride) * 3);
+        }
+    }
+
+    return marchSteps;
+}
+
+int RayMarchingManager::tracePixel(int x, int y, const ShapeList* shapes)
+{
+    const int bufferID = (y * _renderWidth + x) * 3;
+    const SceneData& scene = _scene;
+    const Ray ray = getPixelRay(x, y);
+
+    // A marched ray stops within epsilon of a surface: the spheres are grown by epsilon so that the
+    // silhouettes match, and the hit is shaded from that shell like a marched hit.
+    // Marched rays end at maxDst - 1 (rayDst starts at 1)
+    float nearest = _settings.maxDst - 1;
+    int closest = -1;
+    const int count = shapes ? shapes->count : scene.count;
+    for (int c = 0; c < count; ++c)
+    {
+        const int i = shapeIndex(shapes, c);
+        const glm::vec3 offset = ray.origin - glm::vec3(scene.x[i], scene.y[i], scene.z[i]);
+        const float radius = scene.radius[i] + _settings.epsilon;
+        const float b = glm::dot(offset, ray.direction);
+        const float discriminant = b * b - (glm::dot(offset, offset) - radius * radius);
+        if (discriminant < 0.0f)
+        {
+            continue;
+        }
+
+        // From inside a sphere the ray hits at its origin
+        const float root = std::sqrt(discriminant);
+        const float hitDst = std::max(-b - root, 0.0f);
+        if (b <= root && hitDst < nearest)
+        {
+            nearest = hitDst;
+            closest = i;
+        }
+    }
+
+    if (closest < 0)
+    {
+        shadeBackground(bufferID);
+        return 1;
+    }
+
+    // From inside a sphere, or within epsilon of one, a marched ray stops at its first step,
+    // where the scene distance is negative: shade that step instead of the shell
+    if (nearest == 0.0f)
+    {
+        shadePixel(bufferID, ray.origin, ray.direction, getSceneDistance(ray, shapes), getSceneInfo(ray, shapes));
+        return 1;
+    }
+
+    const glm::vec3 color(scene.colorR[closest], scene.colorG[closest], scene.colorB[closest]);
+    shadePixel(bufferID, ray.origin + ray.direction * nearest, ray.direction, _settings.epsilon, color);
+    return 1;
+}
+
+int RayMarchingManager::tracePacket(int x, int y, int lanes, int stride, const ShapeList* shapes)
+{
+    using namespace simd;
+
+    const SceneData& scene = _scene;
+
+    alignas(32) float originX[LANES], originY[LANES], originZ[LANES];
+    alignas(32) float directionX[LANES], directionY[LANES], directionZ[LANES];
+
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        // Unused lanes duplicate the first used one and are not written
+        const Ray ray = getPixelRay(x + ((lanes & (1 << lane)) ? lane : firstLane(lanes)) * stride, y);
+        originX[lane] = ray.origin.x;
+        originY[lane] = ray.origin.y;
+        originZ[lane] = ray.origin.z;
+        directionX[lane] = ray.direction.x;
+        directionY[lane] = ray.direction.y;
+        directionZ[lane] = ray.direction.z;
+    }
+
+    const floatv ox = floatv::load(originX), oy = floatv::load(originY), oz = floatv::load(originZ);
+    const floatv dx = floatv::load(directionX), dy = floatv::load(directionY), dz = floatv::load(directionZ);
+    const floatv zero = 0.0f;
+
+    // Same intersection as tracePixel, the closest shape index is kept as a float
+    floatv nearest = _settings.maxDst - 1;
+    floatv closest = -1.0f;
+    const int shapeCount = shapes ? shapes->count : scene.count;
+    for (int c = 0; c < shapeCount; ++c)
+    {
+        const int i = shapeIndex(shapes, c);
+        const floatv cx = ox - scene.x[i], cy = oy - scene.y[i], cz = oz - scene.z[i];
+        const floatv radius = scene.radius[i] + _settings.epsilon;
+        const floatv b = cx * dx + cy * dy + cz * dz;
+        const floatv discriminant = b * b - (cx * cx + cy * cy + cz * cz - radius * radius);
+        const floatv root = sqrt(max(discriminant, zero));
+        const floatv hitDst = max(zero - b - root, zero);
+        const floatv hit = (zero <= discriminant) & (b <= root) & (hitDst < nearest);
+        nearest = select(hit, hitDst, nearest);
+        closest = select(hit, floatv((float)i), closest);
+    }
+
+    alignas(32) float hitDst[LANES], hitShape[LANES];
+    nearest.store(hitDst);
+    closest.store(hitShape);
+
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        if (!(lanes & (1 << lane)))
+        {
+            continue;
+        }
+
+        const int bufferID = (y * _renderWidth + x + lane * stride) * 3;
+        const int shape = (int)hitShape[lane];
+        if (shape < 0)
+        {
+            shadeBackground(bufferID);
+            continue;
+        }
+
+        const glm::vec3 origin(originX[lane], originY[lane], originZ[lane]);
+        const glm::vec3 direction(directionX[lane], directionY[lane], directionZ[lane]);
+
+        // Starting inside a sphere, see tracePixel
+        if (hitDst[lane] == 0.0f)
+        {
+            const Ray ray(origin, direction);
+            shadePixel(bufferID, origin, direction, getSceneDistance(ray, shapes), getSceneInfo(ray, shapes));
+            continue;
+        }
+
+        const glm::vec3 color(scene.colorR[shape], scene.colorG[shape], scene.colorB[shape]);
+        shadePixel(bufferID, origin + direction * hitDst[lane], direction, _settings.epsilon, color);
+    }
+
+    return countLanes(lanes);
+}
+
+bool RayMarchingManager::clipRay(const glm::vec3& origin, const glm::vec3& direction, float& enterDst, float& exitDst) const
+{
+    // Slab test against the scene bounds grown by epsilon, hits are accepted that far from the surface
+    const glm::vec3 invDirection = 1.0f / direction;
+    const glm::vec3 t0 = (_scene.boundsMin - _settings.epsilon - origin) * invDirection;
+    const glm::vec3 t1 = (_scene.boundsMax + _settings.epsilon - origin) * invDirection;
+    const glm::vec3 tMin = glm::min(t0, t1);
+    const glm::vec3 tMax = glm::max(t0, t1);
+
+    enterDst = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+    exitDst = std::min(std::min(tMax.x, tMax.y), tMax.z);
+    return enterDst <= exitDst;
+}
+
+Ray RayMarchingManager::getPixelRay(int x, int y)
+{
+    // Shifted samples only run while the view is still, they are not worth caching
+    if (currentSample > 0)
+    {
+        return createCameraRay(getPixelUV((float)x, (float)y));
+    }
+
+    const int pixelID = y * _renderWidth + x;
+    if (_needToUpdateRays)
+    {
+        Ray ray = createCameraRay(getPixelUV((float)x, (float)y));
+        _rays[pixelID] = ray;
+        return ray;
+    }
+
+    return _rays[pixelID];
+}
+
+glm::vec2 RayMarchingManager::getPixelUV(float x, float y) const
+{
+    return glm::vec2((x + _sampleOffset.x) / _renderWidth, (y + _sampleOffset.y) / _renderHeight) * glm::vec2(2.f, 2.f) - glm::vec2(1.f, 1.f);
+}
+
+void RayMarchingManager::accumulate(int bufferID, const glm::vec3& color)
+{
+    const int pixelID = bufferID / 3;
+    const float luminance = dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+
+    // Pixels skipped by adaptive sampling have fewer samples than currentSample
+    glm::vec3 sum = color;
+    float luminanceSq = luminance * luminance;
+    int samples = 1;
+    if (currentSample > 0 && _sampleCount[pixelID] > 0)
+    {
+        sum += glm::vec3(_accumulation[bufferID], _accumulation[bufferID + 1], _accumulation[bufferID + 2]);
+        luminanceSq += _luminanceSq[pixelID];
+        samples += _sampleCount[pixelID];
+    }
+    _accumulation[bufferID] = sum.r;
+    _accumulation[bufferID + 1] = sum.g;
+    _accumulation[bufferID + 2] = sum.b;
+    _luminanceSq[pixelID] = luminanceSq;
+    _sampleCount[pixelID] = samples;
+
+    const glm::vec3 mean = sum / (float)samples;
+    _renderBuffer[bufferID] = (unsigned char)(mean.r);
+    _renderBuffer[bufferID + 1] = (unsigned char)(mean.g);
+    _renderBuffer[bufferID + 2] = (unsigned char)(mean.b);
+
+    _converged[pixelID] = isConverged(sum, luminanceSq, samples);
+}
+
+bool RayMarchingManager::isConverged(const glm::vec3& sum, float luminanceSq, int samples) const
+{
+    // Standard error of the mean luminance: sqrt(variance / samples)
+    const float meanLuminance = dot(sum / (float)samples, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    const float variance = std::max(luminanceSq / samples - meanLuminance * meanLuminance, 0.0f);
+    return _settings.adaptiveSampling && samples >= ADAPTIVE_MIN_SAMPLES
+        && variance < _settings.adaptiveThreshold * _settings.adaptiveThreshold * samples;
+}
+
+void RayMarchingManager::shadePixel(int bufferID, const glm::vec3& origin, const glm::vec3& direction, float dst, const glm::vec3& color)
+{
+    const int pixelID = bufferID / 3;
+    glm::vec3 pointOnSurface = origin + direction * dst;
+
+    // Starts the mean of the pixel, see accumulate(): only then is the G-buffer written, with the shape
+    // (an extra gradient pass outside the analytic normals)
+    const bool writeGBuffer = currentSample == 0 || _sampleCount[pixelID] == 0;
+    int shape = -1;
+    glm::vec3 normal = estimateNormal(pointOnSurface - direction * _settings.epsilon, writeGBuffer ? &shape : nullptr);
+
+    if (currentSample == 0)
+    {
+        _hitPoints[pixelID] = pointOnSurface;
+        _hasHit[pixelID] = true;
+    }
+
+    if (writeGBuffer)
+    {
+        _gbufferPoint[pixelID] = pointOnSurface;
+        _gbufferNormal[pixelID] = normal;
+        _gbufferColor[pixelID] = color;
+        _gbufferShape[pixelID] = shape;
+    }
+
+    accumulate(bufferID, shade(pointOnSurface, normal, color));
+}
+
+glm::vec3 RayMarchingManager::shade(const glm::vec3& point, const glm::vec3& normal, const glm::vec3& color) const
+{
+    glm::vec3 lightDir = (_settings.positionLight) ? normalize(_settings.Light - point) : -_settings.Light;
+    float lighting = saturate(saturate(dot(normal, lightDir)));
+    //float lighting = 1.0f;
+
+    // Shadow
+    //float3 offsetPos = pointOnSurface + normal * shadowBias;
+    //float3 dirToLight = (positionLight) ? normalize(_Light - offsetPos) : -_Light;
+
+    //ray.origin = offsetPos;
+    //ray.direction = dirToLight;
+
+    //float dstToLight = (positionLight) ? distance(offsetPos, _Light) : maxDst;
+    //float shadow = CalculateShadow(ray, dstToLight);
+
+    return color * lighting;
+}
+
+void RayMarchingManager::shadeGBuffer()
+{
+    const int rowBlocks = (_renderHeight + TILE_SIZE - 1) / TILE_SIZE;
+    _threadPool.parallelFor(rowBlocks, [&](int block)
+    {
+        for (int pixelID = block * TILE_SIZE * _renderWidth; pixelID < std::min((block + 1) * TILE_SIZE, _renderHeight) * _renderWidth; ++pixelID)
+        {
+            // Never sampled (checkerboard), the next pass takes its first sample
+            if (_sampleCount[pixelID] == 0)
+            {
+                continue;
+            }
+
+            _sampleCount[pixelID] = 0;
+            accumulate(pixelID * 3, _gbufferShape[pixelID] < 0 ? BACKGROUND_COLOR
+                : shade(_gbufferPoint[pixelID], _gbufferNormal[pixelID], _gbufferColor[pixelID]));
+        }
+    });
+}
+
+void RayMarchingManager::shadeBackground(int bufferID)
+{
+    const int pixelID = bufferID / 3;
+    if (currentSample == 0)
+    {
+        _hasHit[pixelID] = false;
+    }
+
+    if (currentSample == 0 || _sampleCount[pixelID] == 0)
+    {
+        _gbufferShape[pixelID] = -1;
+    }
+
+    accumulate(bufferID, BACKGROUND_COLOR);
+}
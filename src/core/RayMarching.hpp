@@ -0,0 +1,572 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include "CameraManager.hpp"
+#include "RenderOutput.hpp"
+#include "SceneData.hpp"
+#include "ShapeBVH.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+#include <klein/klein.hpp>
+
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    kln::point org;
+
+    Ray(const glm::vec3& o = glm::vec3(0), const glm::vec3& d = glm::vec3(0))
+        : origin(o), direction(d), org(origin.x, origin.y, origin.z)
+    {
+       
+    }
+};
+
+enum class EOperation
+{
+    DEFAULT = 0,
+    BLEND = 1,
+};
+
+struct Shape
+{
+    glm::vec3 position;
+    glm::vec3 size;
+    glm::vec3 color;
+
+    kln::point center;
+
+    std::string name = "shape";
+
+    //int shapeType;
+    EOperation operation = EOperation::DEFAULT;
+    float blendStrength = 0.1f;
+
+    Shape(const glm::vec3& p, const glm::vec3& s, const glm::vec3& c, const std::string& n)
+        : position(p), size(s), color(c), name(n), center(position.x, position.y, position.z)
+    {
+    }
+
+};
+
+enum class ENormalMode
+{
+    CENTRAL_DIFFERENCES = 0, // 6 scene evaluations
+    TETRAHEDRON = 1,         // 4 scene evaluations
+    ANALYTIC = 2,            // closed-form gradient of the spheres, 1 evaluation
+};
+
+struct RayMarchingSettings
+{
+	float maxDst = 10.0f;
+	float epsilon = 0.05f;
+
+	bool positionLight = false;
+	glm::vec3 Light = { 0.9, 0.9, 0.9 };
+
+	int numShapes = 1;
+	std::vector<Shape> shapes;
+
+    bool useP3GA = true;
+
+    // March coherent primary rays simd::LANES at a time, distances are always computed
+    // with the vector formula (the norm of the klein join gives the same value)
+    bool usePackets = true;
+
+    ENormalMode normalMode = ENormalMode::ANALYTIC;
+
+    // Query a BVH instead of folding every shape (scenes of at least BVH_MIN_SHAPES shapes),
+    // distances use the vector formula like the ray packets
+    bool useBVH = true;
+
+    // Enhanced sphere tracing (Keinert et al. 2014): steps of relaxationFactor x distance,
+    // falling back to plain steps when consecutive unbounding spheres do not overlap
+    bool overRelaxation = false;
+    float relaxationFactor = 1.6f;
+
+    // Cone marching pre-pass: one cone per 8x8, 4x4 then 2x2 block of pixels finds
+    // the distance that all its rays can skip before the per-pixel march. The rays then stop at other
+    // points within epsilon of the surfaces: up to 1.5% of the pixels, lit interiors included, shade
+    // more than 8 levels away from rays marched from the camera (see the cone_marching_tolerance test)
+    bool coneMarching = true;
+
+    // Scenes of spheres combined with unions only (no blend) intersect each primary ray with the spheres
+    // in closed form instead of marching it, cones and reprojection are skipped. Not used with the BVH
+    bool analyticSpheres = true;
+
+    // Each frame, bin the shapes into the TILE_SIZE tiles covered by the projection of their bounds:
+    // the rays of a tile only fold its shapes, and a tile of unions only is intersected analytically.
+    // Not used with the BVH, which already skips the far shapes
+    bool tileBinning = true;
+
+    // After ADAPTIVE_MIN_SAMPLES samples, stop sampling the pixels whose mean luminance
+    // has a standard error below adaptiveThreshold (in 8 bit levels)
+    bool adaptiveSampling = true;
+    float adaptiveThreshold = 1.0f;
+
+    // After a camera move, the first sample starts each ray at the previous hit points reprojected
+    // into the new view, minus reprojectionMargin, wherever a 2x2 block and its neighbours are covered.
+    // Not conservative: a surface disoccluded in front of the reprojected depth can be missed
+    bool reprojection = false;
+    float reprojectionMargin = 0.02f;
+
+    // Render at a fraction of the output size, adjusted after each first sample (the frames of a moving
+    // view or of an edit) to fit frameBudgetMs, and upscale into the output buffer
+    bool dynamicResolution = false;
+    float frameBudgetMs = 33.0f;
+    float minRenderScale = 0.25f;
+
+    // The first sample after a view or scene change marches every other pixel in a checkerboard
+    // alternating each frame, the others are reconstructed from the previous frame and their neighbours
+    // until a frame with the same view marches them
+    bool checkerboard = false;
+};
+
+// Counters of the last update(), used to report rays/s and steps/s
+struct RayMarchingStats
+{
+    long long rays = 0;
+    long long marchSteps = 0;
+};
+
+glm::vec4 Blend(float a, float b, const glm::vec3& colA, const glm::vec3& colB, float k);
+
+glm::vec4 Combine(float dstA, float dstB, const glm::vec3& colorA, const glm::vec3& colorB, EOperation operation, float blendStrength);
+
+// Distance of Blend() and Combine() without the colors
+float BlendDistance(float a, float b, float k);
+
+float CombineDistance(float dstA, float dstB, EOperation operation, float blendStrength);
+
+// Edits (the setting getters, getCamera(), the shapes and the Update functions) go to a copy of the
+// settings and camera that the next frame takes as its snapshot when it starts: a frame never sees a
+// half edited scene, and with a RenderThread the edits do not wait for the frame being rendered
+class RayMarchingManager
+{
+public:
+    // threadCount = 0 uses every hardware thread
+    RayMarchingManager(int width, int height, int threadCount = 0);
+
+    // Render the next sample: beginFrame(), renderFrame() and endFrame()
+    void update();
+
+    // Steps of update() for a render thread. beginFrame() and endFrame() read the edits and write what
+    // the editor displays, they must not run during an edit. renderFrame() only reads the frame snapshot.
+    // beginFrame() returns false when there is nothing to render
+    bool beginFrame();
+    RayMarchingStats renderFrame();
+    void endFrame(const RayMarchingStats& stats);
+
+    // Edits are waiting for a frame, or the image is not final yet
+    bool needsUpdate() const
+    {
+        return _viewChanged || _sceneChanged || _restartPending || _lightingChanged || _samplingChanged || !_changedShapes.empty()
+            || currentSample < maxSamples;
+    }
+
+    // Take the edits as the snapshot of the next frame, done by beginFrame().
+    // Needed before calling getSceneInfo() and co directly after an edit
+    void applyChanges();
+
+    // Surface normal at p using _settings.normalMode, and the shape closest to p if requested
+    glm::vec3 estimateNormal(const glm::vec3& p, int* shape = nullptr);
+
+    glm::vec3 estimateNormalCentral(const glm::vec3& p);
+    glm::vec3 estimateNormalTetrahedron(const glm::vec3& p);
+
+    // Gradient of the scene distance (xyz) and the distance itself (w), and the shape closest to p if requested
+    glm::vec4 getSceneGradient(const glm::vec3& p, int* shape = nullptr);
+
+    // Color (xyz) and distance (w) of the scene. With a list, only its shapes are folded:
+    // it must contain every shape that can change the scene around the point
+    glm::vec4 getSceneInfo(const Ray& eyeRay, const ShapeList* shapes = nullptr);
+
+    // Distance of the scene only, what marching needs at each step
+    float getSceneDistance(const Ray& eyeRay, const ShapeList* shapes = nullptr);
+
+    Ray createCameraRay(const glm::vec2& uv);
+
+    float GetShapeDistance(const Shape& shape, const Ray& eye);
+
+    // Output notified after each rendered sample, not owned
+    void setOutput(RenderOutput* output) { _output = output; }
+
+    // Getters
+    Camera& getCamera() { return _editCamera; }
+    int getWidth() const { return _width; }
+    int getHeight() const { return _height; }
+    int getRenderWidth() const { return _renderWidth; }
+    int getRenderHeight() const { return _renderHeight; }
+    int getCurrentSample() const { return currentSample; }
+    int getMaxSamples() const { return maxSamples; }
+    int getThreadCount() const { return _threadPool.getThreadCount(); }
+    const RayMarchingStats& getStats() const { return _stats; }
+    int getNumShapes() const { return _editSettings.numShapes; }
+    const std::vector<Shape>& getShapes() const { return _editSettings.shapes; }
+    std::vector<Shape>& getShapes() { return _editSettings.shapes; }
+    const Shape& getShapeAtIndex(int index) const { return _editSettings.shapes[index]; }
+    Shape& getShapeAtIndex(int index) { return _editSettings.shapes[index]; }
+
+    // Image being rendered, use a RenderOutput instead while a RenderThread runs
+    const std::vector<unsigned char>& getBuffer() const { return _buffer; }
+
+    // Ray Marching Settings
+    float& getEpsilon() { return _editSettings.epsilon; }
+    float& getMaxDistance() { return _editSettings.maxDst; }
+    bool& getUsePGA() { return _editSettings.useP3GA; }
+    bool& getUsePackets() { return _editSettings.usePackets; }
+    ENormalMode& getNormalMode() { return _editSettings.normalMode; }
+    bool& getUseBVH() { return _editSettings.useBVH; }
+    bool& getOverRelaxation() { return _editSettings.overRelaxation; }
+    float& getRelaxationFactor() { return _editSettings.relaxationFactor; }
+    bool& getConeMarching() { return _editSettings.coneMarching; }
+    bool& getAnalyticSpheres() { return _editSettings.analyticSpheres; }
+    bool& getTileBinning() { return _editSettings.tileBinning; }
+    bool& getAdaptiveSampling() { return _editSettings.adaptiveSampling; }
+    float& getAdaptiveThreshold() { return _editSettings.adaptiveThreshold; }
+    bool& getReprojection() { return _editSettings.reprojection; }
+    float& getReprojectionMargin() { return _editSettings.reprojectionMargin; }
+    bool& getDynamicResolution() { return _editSettings.dynamicResolution; }
+    bool& getCheckerboard() { return _editSettings.checkerboard; }
+    float& getFrameBudget() { return _editSettings.frameBudgetMs; }
+    float& getMinRenderScale() { return _editSettings.minRenderScale; }
+    glm::vec3& getLight() { return _editSettings.Light; }
+    bool& getPositionLight() { return _editSettings.positionLight; }
+
+    // Samples accumulated per pixel before update() stops rendering. Raising it keeps the
+    // samples already accumulated, going below the current sample restarts
+    void setMaxSamples(int samples)
+    {
+        maxSamples = std::max(samples, 1);
+        if (currentSample > maxSamples)
+        {
+            _restartPending = true;
+        }
+    }
+
+    // Replace the whole scene, e.g. when loaded from a file
+    void setShapes(const std::vector<Shape>& shapes)
+    {
+        _editSettings.shapes = shapes;
+        _editSettings.numShapes = (int)shapes.size();
+        UpdateScene();
+    }
+
+    // Must be called after any change to the camera
+    void UpdateView() { _viewChanged = true; }
+
+    // Must be called after any change to the shapes or to a setting that changes the image
+    void UpdateScene() { _sceneChanged = true; }
+
+    // Cheaper UpdateScene() after a change to a single shape: only the pixels its old and new
+    // bounds cover on screen are rendered again, the rest of the image keeps its samples
+    void UpdateShape(int index) { _changedShapes.push_back(index); }
+
+    // Cheaper UpdateScene() after a change to the lighting only: the next frame shades the G-buffer
+    // instead of marching, it becomes the first sample and the following ones are marched as usual
+    void UpdateLighting() { _lightingChanged = true; }
+
+    // Cheaper UpdateScene() after a change to the adaptive sampling rule: the samples are kept and tested
+    // again, the pixels no longer converged take the samples they miss
+    void UpdateSampling() { _samplingChanged = true; }
+
+private:
+    // Render every pixel again from the first sample
+    void restartSamples()
+    {
+        currentSample = 0;
+        _regionX0 = 0;
+        _regionY0 = 0;
+        _regionX1 = _renderWidth;
+        _regionY1 = _renderHeight;
+        _partialSamples = false;
+        _checkerboardHalf = false;
+    }
+
+    // Allocate the per pixel state for a render resolution
+    void setRenderSize(int width, int height);
+
+    // Render at scale x the output size, restarts the samples when the size changes
+    void setRenderScale(float scale);
+
+    // Rebuild the scene after UpdateShape() and restrict the first sample to the pixels of the changed shapes
+    void applyShapeChanges();
+
+    // Test the convergence of every pixel again after UpdateSampling(), and go back to the fewest samples
+    // of the pixels left to sample so that they catch up
+    void applySamplingChange();
+
+    // Adaptive sampling: the standard error of the mean luminance of the samples is below the threshold
+    bool isConverged(const glm::vec3& sum, float luminanceSq, int samples) const;
+
+    // Dynamic resolution: adjust the scale to the duration of the last first sample
+    void updateRenderScale(float frameMs);
+
+    // Resample _renderBuffer into _buffer
+    void upscale();
+
+    // March the primary ray of a pixel from startDst and write its color, returns the number of steps.
+    // shapes: those of the pixel's tile, nullptr for every shape
+    int marchPixel(int x, int y, float startDst, const ShapeList* shapes);
+
+    // Same as marchPixel for the pixels x + lane * stride of a row, for each lane set in the `lanes` mask
+    // (others are neither marched nor written), one start distance per lane
+    int marchPacket(int x, int y, int lanes, int stride, const float* startDst, const ShapeList* shapes);
+
+    // Intersect the primary ray of a pixel with every sphere instead of marching it (see useAnalyticSpheres)
+    // and write its color, returns 1: the scene is evaluated once
+    int tracePixel(int x, int y, const ShapeList* shapes);
+
+    // Same as tracePixel for a packet of marchPacket, returns the number of lanes traced
+    int tracePacket(int x, int y, int lanes, int stride, const ShapeList* shapes);
+
+    // Fill the pixels skipped by a checkerboard frame
+    void reconstructCheckerboard();
+
+    // Cone marching pre-pass of the tile [x0, x1) x [y0, y1), writes the start distance of each
+    // CONE_MIN_SIZE block to startDst (row major). Returns the number of steps
+    int marchCones(int x0, int y0, int x1, int y1, bool packets, float* startDst, const ShapeList* shapes);
+
+    // Cone from the camera that contains the primary rays of the pixels [x0, x1) x [y0, y1)
+    void getPixelCone(int x0, int y0, int x1, int y1, glm::vec3& axis, float& spread);
+
+    // Advance coneDst to the distance every ray of the cone can skip, returns the number of steps
+    int marchCone(const glm::vec3& axis, float spread, float& coneDst, const ShapeList* shapes);
+
+    // Same as marchCone for `count` (<= simd::LANES) cones at once
+    int marchConePacket(const glm::vec3* axis, const float* spread, float* coneDst, int count, const ShapeList* shapes);
+
+    // getSceneInfo() for simd::LANES points at once
+    // With bounds (one vector per shape), shapes are only skipped when no lane of `active` needs them
+    void getSceneInfoPacket(const simd::floatv& x, const simd::floatv& y, const simd::floatv& z,
+        simd::floatv& dst, simd::floatv& r, simd::floatv& g, simd::floatv& b, const ShapeList* shapes = nullptr,
+        simd::floatv* bounds = nullptr, const simd::floatv& rayDst = 0.0f, int active = 0);
+
+    // getSceneDistance() for simd::LANES points at once
+    void getSceneDistancePacket(const simd::floatv& x, const simd::floatv& y, const simd::floatv& z, simd::floatv& dst,
+        const ShapeList* shapes = nullptr, simd::floatv* bounds = nullptr, const simd::floatv& rayDst = 0.0f, int active = 0);
+
+    // Closest shape of a DEFAULT run to p, simd::LANES shapes at a time.
+    // Returns the first shape not evaluated (the remainder of the run is left to the caller)
+    int nearestShape(const SceneRun& run, const glm::vec3& p, int& closest, float& closestDst) const;
+
+    // Bit s set when the shape at first + s (< last, at most simd::LANES shapes) in the list, or the scene
+    // without one, may change globalDst. Folding a shape at a distance above globalDst + SceneData::reach
+    // leaves it unchanged: a union keeps the closest shape, a blend past its strength keeps the other side
+    int neededShapes(const simd::floatv* bounds, const ShapeList* shapes, int first, int last, const simd::floatv& rayDst,
+        const simd::floatv& globalDst, int active) const;
+
+    // Start (or restart) the bounds of a packet, every shape is evaluated at the next step
+    void resetRayBounds(simd::floatv* bounds) const;
+
+    bool useRayBounds() const { return !useBVH() && _scene.count <= RAY_BOUNDS_MAX_SHAPES; }
+
+    bool useBVH() const { return _settings.useBVH && _scene.count >= BVH_MIN_SHAPES && _bvhSelective; }
+
+    // Build the BVH of _scene and check that its queries stay under BVH_MAX_CANDIDATES
+    void buildBVH();
+
+    // Unions of spheres have closed-form hits, a blend changes the surface between its shapes.
+    // For the shapes of a list (a tile's), or the whole scene without one
+    bool useAnalyticSpheres(const ShapeList* shapes = nullptr) const;
+
+    bool useTileBinning() const { return _settings.tileBinning && !useBVH(); }
+
+    // Fill the shape list of each tile, in fold order, from the projection of the shapes' bounds
+    void binShapes(int tilesX, int tilesY);
+
+    // Shapes binned into a tile by the last binShapes()
+    ShapeList getTileShapes(int tile) const
+    {
+        return { _tileShapes.data() + _tileShapeStart[tile], _tileShapeStart[tile + 1] - _tileShapeStart[tile] };
+    }
+
+    // Pixels covered by a sphere of the scene, false if it is behind the camera
+    bool projectSphere(const glm::vec3& center, float radius, glm::vec2& pixelMin, glm::vec2& pixelMax) const;
+
+    // Shapes that can affect the scene at p, -1 if too many (fold every shape then)
+    int gatherShapes(const glm::vec3& p, int* indices) const;
+
+    // Distances along the ray where it enters and leaves the scene bounds, false if it misses them
+    bool clipRay(const glm::vec3& origin, const glm::vec3& direction, float& enterDst, float& exitDst) const;
+
+    // Primary ray of a pixel for the current sample, the first sample is cached until the view changes
+    Ray getPixelRay(int x, int y);
+
+    // Camera uv of a pixel, shifted by the sub-pixel offset of the current sample
+    glm::vec2 getPixelUV(float x, float y) const;
+
+    // Add a sample of the current pass to the pixel mean and write it to _renderBuffer
+    void accumulate(int bufferID, const glm::vec3& color);
+
+    // Inverse of the uv to direction transform of createCameraRay, (u, v) * z = M * (p - origin)
+    glm::mat3 getDirectionToUV() const;
+
+    // Splat the hit points of the previous view into _reprojectedDst
+    void reprojectHits();
+
+    // Start distance of the CONE_MIN_SIZE block at (x, y) from the reprojected hits, 0 if not covered
+    float getReprojectedStart(int x, int y) const;
+
+    // False once adaptive sampling considers the pixel converged, outside the region of the first
+    // sample, or skipped by a checkerboard frame. After UpdateShape() the pixels kept from before
+    // already have more samples than currentSample and wait for it to catch up
+    bool needsSample(int x, int y) const
+    {
+        if (currentSample > 0)
+        {
+            const int pixelID = y * _renderWidth + x;
+            return !_converged[pixelID] && _sampleCount[pixelID] <= currentSample;
+        }
+        return x >= _regionX0 && x < _regionX1 && y >= _regionY0 && y < _regionY1
+            && (!_checkerboardFrame || ((x + y) & 1) == _checkerboardParity);
+    }
+
+    // Fill the G-buffer on the first sample of a pixel, then shade and accumulate
+    void shadePixel(int bufferID, const glm::vec3& origin, const glm::vec3& direction, float dst, const glm::vec3& color);
+    void shadeBackground(int bufferID);
+
+    // Lambert shading of a surface point, shared by the march and the G-buffer pass
+    glm::vec3 shade(const glm::vec3& point, const glm::vec3& normal, const glm::vec3& color) const;
+
+    // Shading pass: restart the mean of every sampled pixel with its G-buffer shaded again
+    void shadeGBuffer();
+
+private:
+    // Frames are split in TILE_SIZE x TILE_SIZE tiles distributed to the thread pool
+    static const int TILE_SIZE = 16;
+
+    // Cone marching pre-pass block sizes, in pixels
+    static const int CONE_MAX_SIZE = 8;
+    static const int CONE_MIN_SIZE = 2;
+
+    // Samples taken before a pixel can be considered converged
+    static const int ADAPTIVE_MIN_SAMPLES = 8;
+
+    // Reprojected blocks whose depths span more than this many margins are marched from the cones
+    static constexpr float REPROJECTION_MAX_RANGE = 4.0f;
+
+    // Below this many shapes the SIMD linear fold is cheaper than the BVH (measured with RayMarchingBench)
+    static const int BVH_MIN_SHAPES = 512;
+    static const int BVH_MAX_CANDIDATES = 32;
+
+    // An overflowing query folds every shape one at a time: dense blend scenes, where the margin of
+    // the strongest blend keeps most shapes, are folded linearly (packets, tile binning) instead
+    static const int BVH_PROBES = 64;
+    static constexpr float BVH_MAX_OVERFLOW = 0.25f;
+
+    // Marching packets keep a lower bound of the distance of each lane to each shape: the point moves by the
+    // step it takes, so a shape at dst when the ray was at rayDst is still at least dst - (rayDst' - rayDst) away.
+    // Bounds are kept on the stack, for scenes folded linearly only (the BVH already skips far shapes).
+    // Single rays do not use them: their fold is cheap enough that the test, which waits for the fold, costs more
+    static const int RAY_BOUNDS_MAX_SHAPES = BVH_MIN_SHAPES;
+
+    // A shape is skipped when its bound is this many epsilons above what it could change,
+    // the ray distance and the point drift apart by rounding
+    static constexpr float RAY_BOUNDS_MARGIN = 0.1f;
+
+    // Snapshot of the edits rendered by the current frame, its shape table stays empty
+    RayMarchingSettings _settings;
+
+    // Packed copy of _editSettings.shapes read by the march loop
+    SceneData _scene;
+    ShapeBVH _bvh;
+    bool _bvhSelective = true;
+
+    // Shapes of each tile of the frame, tile t lists _tileShapes[_tileShapeStart[t] .. _tileShapeStart[t + 1])
+    std::vector<int> _tileShapeStart;
+    std::vector<int> _tileShapes;
+
+    // Tiles [x, z] x [y, w] covered by each shape, empty when x > z
+    std::vector<glm::ivec4> _shapeTiles;
+
+    Camera _camera;
+
+    // Edits since the last frame started, see applyChanges()
+    RayMarchingSettings _editSettings;
+    Camera _editCamera;
+    bool _viewChanged = true;
+    bool _sceneChanged = true;
+    bool _restartPending = false;
+    bool _lightingChanged = false;
+    bool _samplingChanged = false;
+    std::vector<int> _changedShapes;
+    
+    int _width;
+    int _height;
+    int _nbpixels;
+    int _bufferSize;
+    std::vector<unsigned char> _buffer;
+
+    // Resolution the rays are marched at, the output size unless dynamic resolution lowers it.
+    // Every per pixel vector below is at this resolution
+    float _renderScale = 1.0f;
+    int _renderWidth;
+    int _renderHeight;
+    int _renderPixels;
+    std::vector<unsigned char> _renderBuffer;
+
+    RenderOutput* _output = nullptr;
+
+    RayMarchingStats _stats;
+
+    ThreadPool _threadPool;
+
+    glm::vec3 _rayOrigin;
+
+    // Rays of the first sample (no sub-pixel offset)
+    std::vector<Ray> _rays;
+
+    // Sum of the samples of each pixel, RGB
+    std::vector<float> _accumulation;
+
+    // Per pixel sample count, sum of the squared luminance and convergence for adaptive sampling
+    std::vector<int> _sampleCount;
+    std::vector<float> _luminanceSq;
+    std::vector<unsigned char> _converged;
+
+    // Hit of the first sample of each pixel, reprojected after a camera move
+    std::vector<glm::vec3> _hitPoints;
+    std::vector<unsigned char> _hasHit;
+    std::vector<float> _reprojectedDst;
+    bool _hitPointsValid = false;
+    bool _reprojectionPending = false;
+
+    // G-buffer: hit point, normal, base color and shape (-1 for the background) of the first sample
+    // in the mean of each pixel, valid while the pixel has samples. Re-shaded after UpdateLighting()
+    std::vector<glm::vec3> _gbufferPoint;
+    std::vector<glm::vec3> _gbufferNormal;
+    std::vector<glm::vec3> _gbufferColor;
+    std::vector<int> _gbufferShape;
+    bool _shadingFrame = false;
+
+    std::chrono::steady_clock::time_point _frameStart;
+
+    // _checkerboardHalf: the last frame was the first checkerboard half of the first sample.
+    // _renderBufferValid: _renderBuffer holds a frame of the render size, to reconstruct the skipped pixels from
+    bool _checkerboardFrame = false;
+    bool _checkerboardHalf = false;
+    bool _renderBufferValid = false;
+    int _checkerboardParity = 0;
+    glm::vec2 _sampleOffset = glm::vec2(0);
+
+    // Pixels [x0, x1) x [y0, y1) rendered by the first sample, the whole image unless UpdateShape() shrinks it.
+    // _partialSamples: the image has pixels kept from before the restart
+    int _regionX0 = 0;
+    int _regionY0 = 0;
+    int _regionX1 = 0;
+    int _regionY1 = 0;
+    bool _partialSamples = false;
+
+    int currentSample = 0;
+    int maxSamples = 20;
+
+    bool _needToUpdateRays = true; // If camera move, we must compute new rays
+};
+
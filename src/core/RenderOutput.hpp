@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+
+
+// Destination of the frames produced by RayMarchingManager (GL texture, image file...)
+class RenderOutput
+{
+public:
+	virtual ~RenderOutput() = default;
+
+	// Called each time a new sample has been written into the RGB8 buffer
+	virtual void present(const std::vector<unsigned char>& buffer, int width, int height) = 0;
+};
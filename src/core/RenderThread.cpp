@@ -0,0 +1,71 @@
+#include "RenderThread.hpp"
+
+#include "RayMarching.hpp"
+
+
+RenderThread::RenderThread(RayMarchingManager& rayMarching)
+    : _rayMarching(rayMarching)
+{
+    _rayMarching.setOutput(this);
+    _thread = std::thread(&RenderThread::renderLoop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(_editMutex);
+        _stop = true;
+    }
+    _wakeUp.notify_one();
+    _thread.join();
+
+    _rayMarching.setOutput(nullptr);
+}
+
+bool RenderThread::presentFrame(RenderOutput& output)
+{
+    std::lock_guard<std::mutex> lock(_frameMutex);
+    if (!_newFrame)
+    {
+        return false;
+    }
+
+    output.present(_frame, _frameWidth, _frameHeight);
+    _newFrame = false;
+    return true;
+}
+
+void RenderThread::present(const std::vector<unsigned char>& buffer, int width, int height)
+{
+    std::lock_guard<std::mutex> lock(_frameMutex);
+    _frame = buffer;
+    _frameWidth = width;
+    _frameHeight = height;
+    _newFrame = true;
+}
+
+void RenderThread::renderLoop()
+{
+    std::unique_lock<std::mutex> lock(_editMutex);
+    while (true)
+    {
+        // Sleep once the image is final, until the next edit
+        _wakeUp.wait(lock, [this]() { return _stop || _rayMarching.needsUpdate(); });
+        if (_stop)
+        {
+            return;
+        }
+
+        if (!_rayMarching.beginFrame())
+        {
+            continue;
+        }
+
+        // The UI can edit while the frame renders its snapshot
+        lock.unlock();
+        const RayMarchingStats stats = _rayMarching.renderFrame();
+        lock.lock();
+
+        _rayMarching.endFrame(stats);
+    }
+}
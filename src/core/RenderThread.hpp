@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "RenderOutput.hpp"
+
+class RayMarchingManager;
+
+
+// Runs RayMarchingManager::update() on its own thread, so that a slow frame does not block the UI.
+// The UI edits the manager while holding lock(), which the render thread only takes between frames,
+// and presents the newest completed image, kept in a second buffer while the next one is rendered.
+class RenderThread : public RenderOutput
+{
+public:
+	// Becomes the output of rayMarching until destroyed
+	explicit RenderThread(RayMarchingManager& rayMarching);
+	~RenderThread();
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	// Held while reading or editing the manager
+	std::unique_lock<std::mutex> lock() { return std::unique_lock<std::mutex>(_editMutex); }
+
+	// Wake the render thread after an edit, without holding lock()
+	void notify() { _wakeUp.notify_one(); }
+
+	// Give the newest completed image to output, false if it has already been given
+	bool presentFrame(RenderOutput& output);
+
+	// Called by the render thread at the end of each frame
+	void present(const std::vector<unsigned char>& buffer, int width, int height) override;
+
+private:
+	void renderLoop();
+
+private:
+	RayMarchingManager& _rayMarching;
+
+	std::mutex _editMutex;
+	std::condition_variable _wakeUp;
+	bool _stop = false;
+
+	// Newest completed image
+	std::mutex _frameMutex;
+	std::vector<unsigned char> _frame;
+	int _frameWidth = 0;
+	int _frameHeight = 0;
+	bool _newFrame = false;
+
+	std::thread _thread;
+};
@@ -0,0 +1,67 @@
+#include "SceneData.hpp"
+
+#include "RayMarching.hpp"
+
+#include <algorithm>
+#include <limits>
+
+
+void SceneData::build(const std::vector<Shape>& shapes, int numShapes)
+{
+    count = std::min(numShapes, (int)shapes.size());
+
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    radius.resize(count);
+    blendStrength.resize(count);
+    operation.resize(count);
+    colorR.resize(count);
+    colorG.resize(count);
+    colorB.resize(count);
+    center.resize(count);
+    reach.resize(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        const Shape& shape = shapes[i];
+
+        x[i] = shape.position.x;
+        y[i] = shape.position.y;
+        z[i] = shape.position.z;
+        radius[i] = shape.size.x;
+        blendStrength[i] = shape.blendStrength;
+        operation[i] = shape.operation;
+        colorR[i] = shape.color.r;
+        colorG[i] = shape.color.g;
+        colorB[i] = shape.color.b;
+        center[i] = shape.center;
+        reach[i] = shape.operation == EOperation::BLEND ? shape.blendStrength : 0.0f;
+    }
+
+    runs.clear();
+    for (int i = 0; i < count; ++i)
+    {
+        if (runs.empty() || runs.back().operation != operation[i])
+        {
+            runs.push_back({ i, i, operation[i] });
+        }
+        runs.back().end = i + 1;
+    }
+
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    float blendMargin = 0.0f;
+    for (int i = 0; i < count; ++i)
+    {
+        const glm::vec3 position(x[i], y[i], z[i]);
+        boundsMin = glm::min(boundsMin, position - radius[i]);
+        boundsMax = glm::max(boundsMax, position + radius[i]);
+        if (operation[i] == EOperation::BLEND)
+        {
+            blendMargin += 0.25f * blendStrength[i];
+        }
+    }
+    boundsMin -= blendMargin;
+    boundsMax += blendMargin;
+}
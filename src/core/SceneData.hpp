@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include <klein/klein.hpp>
+
+struct Shape;
+enum class EOperation;
+
+
+// std::allocator returning memory aligned for simd::floatv loads
+template <typename T, std::size_t Alignment = 32>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+    void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T> >;
+
+
+// Consecutive shapes sharing the same operation
+struct SceneRun
+{
+    int begin;
+    int end;
+    EOperation operation;
+};
+
+// Subset of the shapes in fold (ascending) order, e.g. the shapes binned into a tile
+struct ShapeList
+{
+    const int* indices;
+    int count;
+};
+
+// Structure of arrays copy of the shapes, only the fields read while marching.
+// Rebuilt from RayMarchingSettings::shapes each time the scene changes,
+// names and other editor data stay in the Shape table.
+struct SceneData
+{
+    int count = 0;
+
+    AlignedVector<float> x;
+    AlignedVector<float> y;
+    AlignedVector<float> z;
+    AlignedVector<float> radius;
+    AlignedVector<float> blendStrength;
+    AlignedVector<EOperation> operation;
+
+    // Distance above the folded scene distance within which a shape can still change it:
+    // its strength for a blend, 0 for a union
+    AlignedVector<float> reach;
+
+    AlignedVector<float> colorR;
+    AlignedVector<float> colorG;
+    AlignedVector<float> colorB;
+
+    // Centers for the klein distance
+    AlignedVector<kln::point> center;
+
+    // DEFAULT runs are order independent (plain min), BLEND runs must be folded in order
+    std::vector<SceneRun> runs;
+
+    // Box containing every surface of the scene, boundsMin > boundsMax when empty.
+    // Each blend can pull the surface out by a quarter of its strength, the box is inflated by their sum
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    void build(const std::vector<Shape>& shapes, int numShapes);
+};
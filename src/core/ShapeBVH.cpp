@@ -0,0 +1,238 @@
+#include "ShapeBVH.hpp"
+
+#include "RayMarching.hpp"
+
+#include <algorithm>
+#include <limits>
+
+
+// Extent of a shape for the BVH, BLEND shapes influence up to blendStrength further
+static float boundingRadius(const SceneData& scene, int i)
+{
+    return scene.radius[i] + (scene.operation[i] == EOperation::BLEND ? scene.blendStrength[i] : 0.0f);
+}
+
+void ShapeBVH::build(const SceneData& scene)
+{
+    _nodes.clear();
+    _shapes.resize(scene.count);
+    _blendMargin = 0.0f;
+
+    for (int i = 0; i < scene.count; ++i)
+    {
+        _shapes[i] = i;
+        if (scene.operation[i] == EOperation::BLEND)
+        {
+            _blendMargin = std::max(_blendMargin, BLEND_MARGIN * scene.blendStrength[i]);
+        }
+    }
+
+    if (scene.count > 0)
+    {
+        _nodes.reserve(2 * scene.count);
+        buildNode(scene, 0, scene.count);
+    }
+}
+
+int ShapeBVH::buildNode(const SceneData& scene, int first, int count)
+{
+    const int index = (int)_nodes.size();
+    _nodes.push_back(Node());
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    glm::vec3 centroidMin = boundsMin;
+    glm::vec3 centroidMax = boundsMax;
+    for (int i = first; i < first + count; ++i)
+    {
+        const int shape = _shapes[i];
+        const glm::vec3 center(scene.x[shape], scene.y[shape], scene.z[shape]);
+        const float radius = boundingRadius(scene, shape);
+        boundsMin = glm::min(boundsMin, center - radius);
+        boundsMax = glm::max(boundsMax, center + radius);
+        centroidMin = glm::min(centroidMin, center);
+        centroidMax = glm::max(centroidMax, center);
+    }
+
+    _nodes[index].boundsMin = boundsMin;
+    _nodes[index].boundsMax = boundsMax;
+
+    if (count <= LEAF_SIZE)
+    {
+        _nodes[index].first = first;
+        _nodes[index].count = count;
+        _nodes[index].right = -1;
+        return index;
+    }
+
+    // Median split along the largest extent of the centers
+    const glm::vec3 extent = centroidMax - centroidMin;
+    const int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+    const float* coordinates = axis == 0 ? scene.x.data() : (axis == 1 ? scene.y.data() : scene.z.data());
+
+    const int half = count / 2;
+    std::nth_element(_shapes.begin() + first, _shapes.begin() + first + half, _shapes.begin() + first + count,
+        [coordinates](int a, int b) { return coordinates[a] < coordinates[b]; });
+
+    buildNode(scene, first, half);
+    const int right = buildNode(scene, first + half, count - half);
+
+    _nodes[index].first = first;
+    _nodes[index].count = 0;
+    _nodes[index].right = right;
+    return index;
+}
+
+// Squared distance from p to a box, 0 inside
+static float boxDistance2(const glm::vec3& p, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 outside = glm::max(glm::max(boundsMin - p, p - boundsMax), glm::vec3(0.0f));
+    return glm::dot(outside, outside);
+}
+
+int ShapeBVH::gather(const SceneData& scene, const glm::vec3& p, float maxDst, int* indices, int capacity) const
+{
+    if (_nodes.empty())
+    {
+        return 0;
+    }
+
+    // Shapes are kept while their distance minus their own blend strength is below best + _blendMargin,
+    // best being the smallest shape distance seen so far (an upper bound of the folded distance).
+    // The kept shapes are folded in their original order by the caller.
+    struct Candidate
+    {
+        int shape;
+        float reach; // distance - own blend strength
+    };
+
+    const int MAX_CANDIDATES = 64;
+    Candidate candidates[MAX_CANDIDATES];
+    int candidateCount = 0;
+    bool overflow = false;
+
+    float best = maxDst;
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        // Inside a box the distance says nothing (p may be inside several shapes), always visit
+        const Node& node = _nodes[stack[--stackSize]];
+        const float nodeDst2 = boxDistance2(p, node.boundsMin, node.boundsMax);
+        const float limit = best + _blendMargin;
+        if (nodeDst2 > 0.0f && (limit < 0.0f || nodeDst2 > limit * limit))
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (int i = node.first; i < node.first + node.count; ++i)
+            {
+                const int shape = _shapes[i];
+                const float dst = glm::distance(p, glm::vec3(scene.x[shape], scene.y[shape], scene.z[shape])) - scene.radius[shape];
+                const float reach = dst - (boundingRadius(scene, shape) - scene.radius[shape]);
+
+                best = std::min(best, dst);
+                if (reach > best + _blendMargin)
+                {
+                    continue;
+                }
+
+                // Drop candidates that the new best made irrelevant before giving up
+                if (candidateCount == MAX_CANDIDATES)
+                {
+                    int kept = 0;
+                    for (int c = 0; c < candidateCount; ++c)
+                    {
+                        if (candidates[c].reach <= best + _blendMargin)
+                        {
+                            candidates[kept++] = candidates[c];
+                        }
+                    }
+                    candidateCount = kept;
+                }
+
+                if (candidateCount == MAX_CANDIDATES)
+                {
+                    overflow = true;
+                    break;
+                }
+
+                candidates[candidateCount++] = { shape, reach };
+            }
+        }
+        else
+        {
+            // Visit the closest child first so best shrinks quickly
+            const int left = (int)(&node - _nodes.data()) + 1;
+            const int right = node.right;
+            const float leftDst = boxDistance2(p, _nodes[left].boundsMin, _nodes[left].boundsMax);
+            const float rightDst = boxDistance2(p, _nodes[right].boundsMin, _nodes[right].boundsMax);
+            if (leftDst < rightDst)
+            {
+                stack[stackSize++] = right;
+                stack[stackSize++] = left;
+            }
+            else
+            {
+                stack[stackSize++] = left;
+                stack[stackSize++] = right;
+            }
+        }
+
+        if (overflow)
+        {
+            break;
+        }
+    }
+
+    int count = 0;
+    for (int c = 0; c < candidateCount && !overflow; ++c)
+    {
+        if (candidates[c].reach <= best + _blendMargin)
+        {
+            if (count == capacity)
+            {
+                overflow = true;
+                break;
+            }
+            indices[count++] = candidates[c].shape;
+        }
+    }
+
+    if (overflow)
+    {
+        return -1;
+    }
+
+    std::sort(indices, indices + count);
+    return count;
+}
+
+float ShapeBVH::overflowRate(const SceneData& scene, float maxDst, int capacity, int probes) const
+{
+    if (scene.count == 0)
+    {
+        return 0.0f;
+    }
+
+    // Marching spends its steps close to surfaces, probe there
+    std::vector<int> indices(capacity);
+    const int stride = std::max(1, scene.count / probes);
+    int probed = 0;
+    int overflows = 0;
+    for (int i = 0; i < scene.count; i += stride, ++probed)
+    {
+        const glm::vec3 p(scene.x[i] + scene.radius[i], scene.y[i], scene.z[i]);
+        if (gather(scene, p, maxDst, indices.data(), capacity) < 0)
+        {
+            ++overflows;
+        }
+    }
+
+    return (float)overflows / probed;
+}
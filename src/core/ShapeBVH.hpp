@@ -0,0 +1,54 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include <vector>
+
+struct SceneData;
+
+
+// Bounding volume hierarchy over the shapes of a SceneData.
+// Boxes bound each sphere inflated by its blend strength (BLEND shapes reach that far),
+// the query returns the shapes that can still change the folded scene distance at a point.
+class ShapeBVH
+{
+public:
+	void build(const SceneData& scene);
+
+	bool empty() const { return _nodes.empty(); }
+
+	// Distance above the best one within which a shape can still change the fold, see BLEND_MARGIN
+	float getBlendMargin() const { return _blendMargin; }
+
+	// Indices (ascending, i.e. fold order) of the shapes that can affect the scene distance at p.
+	// Returns -1 when more than `capacity` shapes are candidates, the caller must then fold every shape.
+	int gather(const SceneData& scene, const glm::vec3& p, float maxDst, int* indices, int capacity) const;
+
+	// Fraction of gather() queries returning -1, probed on the surface of up to `probes` shapes spread over the scene
+	float overflowRate(const SceneData& scene, float maxDst, int capacity, int probes) const;
+
+private:
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		int right;  // internal node: index of the second child, the first one is the next node
+		int first;  // leaf: first entry in _shapes
+		int count;  // leaf: number of shapes, 0 for internal nodes
+	};
+
+	int buildNode(const SceneData& scene, int first, int count);
+
+private:
+	static const int LEAF_SIZE = 4;
+
+	// A far shape changes the fold only if it is blended with a shape whose distance is within
+	// its blend strength, possibly through a chain of blended neighbours: keep shapes up to
+	// BLEND_MARGIN times the largest blend strength above the best distance
+	static constexpr float BLEND_MARGIN = 4.0f;
+
+	std::vector<Node> _nodes;
+	std::vector<int> _shapes;
+
+	// BLEND_MARGIN x the largest blend strength of the scene, 0 without BLEND shapes
+	float _blendMargin = 0.0f;
+};
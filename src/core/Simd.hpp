@@ -0,0 +1,124 @@
+#pragma once
+
+// Minimal float vector used by the ray packet kernels.
+// 8 lanes when the core is compiled with AVX (RAYMARCHING_NATIVE), 4 lanes (SSE) otherwise.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace simd
+{
+
+#if defined(__AVX__)
+
+constexpr int LANES = 8;
+
+struct floatv
+{
+    __m256 v;
+
+    floatv() = default;
+    floatv(__m256 value) : v(value) {}
+    floatv(float value) : v(_mm256_set1_ps(value)) {}
+
+    static floatv load(const float* p) { return _mm256_load_ps(p); }
+    static floatv loadu(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const { _mm256_store_ps(p, v); }
+};
+
+inline floatv operator+(floatv a, floatv b) { return _mm256_add_ps(a.v, b.v); }
+inline floatv operator-(floatv a, floatv b) { return _mm256_sub_ps(a.v, b.v); }
+inline floatv operator*(floatv a, floatv b) { return _mm256_mul_ps(a.v, b.v); }
+inline floatv operator/(floatv a, floatv b) { return _mm256_div_ps(a.v, b.v); }
+inline floatv operator<(floatv a, floatv b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline floatv operator<=(floatv a, floatv b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline floatv operator&(floatv a, floatv b) { return _mm256_and_ps(a.v, b.v); }
+inline floatv operator|(floatv a, floatv b) { return _mm256_or_ps(a.v, b.v); }
+
+inline floatv min(floatv a, floatv b) { return _mm256_min_ps(a.v, b.v); }
+inline floatv max(floatv a, floatv b) { return _mm256_max_ps(a.v, b.v); }
+inline floatv sqrt(floatv a) { return _mm256_sqrt_ps(a.v); }
+
+// mask ? a : b, mask lanes are all ones or all zeros
+inline floatv select(floatv mask, floatv a, floatv b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+
+// One bit per lane, set where the mask lane is true
+inline int movemask(floatv mask) { return _mm256_movemask_ps(mask.v); }
+
+#else
+
+constexpr int LANES = 4;
+
+struct floatv
+{
+    __m128 v;
+
+    floatv() = default;
+    floatv(__m128 value) : v(value) {}
+    floatv(float value) : v(_mm_set1_ps(value)) {}
+
+    static floatv load(const float* p) { return _mm_load_ps(p); }
+    static floatv loadu(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_store_ps(p, v); }
+};
+
+inline floatv operator+(floatv a, floatv b) { return _mm_add_ps(a.v, b.v); }
+inline floatv operator-(floatv a, floatv b) { return _mm_sub_ps(a.v, b.v); }
+inline floatv operator*(floatv a, floatv b) { return _mm_mul_ps(a.v, b.v); }
+inline floatv operator/(floatv a, floatv b) { return _mm_div_ps(a.v, b.v); }
+inline floatv operator<(floatv a, floatv b) { return _mm_cmplt_ps(a.v, b.v); }
+inline floatv operator<=(floatv a, floatv b) { return _mm_cmple_ps(a.v, b.v); }
+inline floatv operator&(floatv a, floatv b) { return _mm_and_ps(a.v, b.v); }
+inline floatv operator|(floatv a, floatv b) { return _mm_or_ps(a.v, b.v); }
+
+inline floatv min(floatv a, floatv b) { return _mm_min_ps(a.v, b.v); }
+inline floatv max(floatv a, floatv b) { return _mm_max_ps(a.v, b.v); }
+inline floatv sqrt(floatv a) { return _mm_sqrt_ps(a.v); }
+
+// mask ? a : b, mask lanes are all ones or all zeros
+inline floatv select(floatv mask, floatv a, floatv b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+
+// One bit per lane, set where the mask lane is true
+inline int movemask(floatv mask) { return _mm_movemask_ps(mask.v); }
+
+#endif
+
+// 0, 1, 2 ... LANES - 1
+inline floatv laneIndex()
+{
+    alignas(32) static const float index[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    return floatv::load(index);
+}
+
+// Index of the lowest lane set in a movemask() result, mask != 0
+inline int firstLane(int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, (unsigned long)mask);
+    return (int)index;
+#else
+    return __builtin_ctz((unsigned)mask);
+#endif
+}
+
+// Number of lanes set in a movemask() result
+inline int countLanes(int mask)
+{
+    int count = 0;
+    for (; mask; mask &= mask - 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+} // namespace simd
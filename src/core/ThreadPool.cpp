@@ -0,0 +1,139 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount <= 0)
+    {
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        _queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    for (int i = 1; i < threadCount; ++i)
+    {
+        _threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wakeUp.notify_all();
+
+    for (std::thread& thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(int taskCount, const std::function<void(int)>& task)
+{
+    if (taskCount <= 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _remaining = taskCount;
+    }
+
+    // Contiguous ranges per worker keep neighbouring tiles on the same core
+    const int workers = getThreadCount();
+    for (int worker = 0; worker < workers; ++worker)
+    {
+        int begin = (int)((long long)taskCount * worker / workers);
+        int end = (int)((long long)taskCount * (worker + 1) / workers);
+
+        std::lock_guard<std::mutex> lock(_queues[worker]->mutex);
+        for (int i = begin; i < end; ++i)
+        {
+            _queues[worker]->tasks.push_back(i);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _generation++;
+    }
+    _wakeUp.notify_all();
+
+    while (runTask(0))
+    {
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finished.wait(lock, [this]() { return _remaining == 0; });
+    _task = nullptr;
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+    unsigned int generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeUp.wait(lock, [&]() { return _stop || _generation != generation; });
+            if (_stop)
+            {
+                return;
+            }
+            generation = _generation;
+        }
+
+        while (runTask(worker))
+        {
+        }
+    }
+}
+
+bool ThreadPool::runTask(int worker)
+{
+    int task = -1;
+    const int workers = getThreadCount();
+    for (int i = 0; i < workers && task < 0; ++i)
+    {
+        WorkQueue& queue = *_queues[(worker + i) % workers];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            continue;
+        }
+
+        if (i == 0)
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        else
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+    }
+
+    if (task < 0)
+    {
+        return false;
+    }
+
+    (*_task)(task);
+
+    if (--_remaining == 0)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _finished.notify_all();
+    }
+    return true;
+}
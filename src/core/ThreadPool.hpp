@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Persistent worker threads running indexed tasks.
+// Each worker owns a deque of task indices and steals from the others once its own is empty,
+// so cheap and expensive tasks (sky vs silhouette tiles) balance out.
+class ThreadPool
+{
+public:
+	// threadCount includes the calling thread, 0 = std::thread::hardware_concurrency()
+	explicit ThreadPool(int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int getThreadCount() const { return (int)_queues.size(); }
+
+	// Run task(0) ... task(taskCount - 1), returns once all of them are done.
+	// The calling thread works too, tasks must not call parallelFor themselves.
+	void parallelFor(int taskCount, const std::function<void(int)>& task);
+
+private:
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<int> tasks;
+	};
+
+	void workerLoop(int worker);
+
+	// Run one task from our own queue (front) or stolen from another one (back)
+	bool runTask(int worker);
+
+private:
+	std::vector<std::thread> _threads;
+	std::vector<std::unique_ptr<WorkQueue> > _queues; // [0] is the calling thread
+
+	std::mutex _mutex;
+	std::condition_variable _wakeUp;
+	std::condition_variable _finished;
+
+	const std::function<void(int)>* _task = nullptr;
+	std::atomic<int> _remaining{ 0 };
+	unsigned int _generation = 0;
+	bool _stop = false;
+};
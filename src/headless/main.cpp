@@ -0,0 +1,280 @@
+// Render a single frame without any window or OpenGL context
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "RayMarching.hpp"
+
+
+static void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]" << std::endl
+        << "  --width <n>            Image width (default 600)" << std::endl
+        << "  --height <n>           Image height (default 400)" << std::endl
+        << "  --scene <file>         Scene description file" << std::endl
+        << "  --eye <x> <y> <z>      Camera position (default 0 0 -4)" << std::endl
+        << "  --center <x> <y> <z>   Camera target (default 0 0 0)" << std::endl
+        << "  --epsilon <e>          Surface epsilon" << std::endl
+        << "  --max-distance <d>     Maximum marching distance" << std::endl
+        << "  --samples <n>          Anti-aliasing samples per pixel (default 20)" << std::endl
+        << "  --no-adaptive          Take every sample of every pixel" << std::endl
+        << "  --threads <n>          Render threads (default: all hardware threads)" << std::endl
+        << "  --no-pga               Use the glm distance instead of klein" << std::endl
+        << "  --no-packets           March one ray at a time instead of SIMD packets" << std::endl
+        << "  --no-bvh               Fold every shape at each step instead of querying the BVH" << std::endl
+        << "  --no-cones             Skip the cone marching pre-pass" << std::endl
+        << "  --no-analytic          March scenes of unions instead of intersecting the spheres" << std::endl
+        << "  --no-binning           Fold every shape in every tile instead of the tile's shapes" << std::endl
+        << "  --relaxation <w>       Over-relaxed sphere tracing with factor w (1 < w < 2)" << std::endl
+        << "  --normals <mode>       central, tetrahedron or analytic (default)" << std::endl
+        << "  --output <file>        Output image, binary PPM (default out.ppm)" << std::endl
+        << std::endl
+        << "Scene file: one shape per line, '#' starts a comment" << std::endl
+        << "  sphere <x> <y> <z> <radius> <r> <g> <b> [default | blend <strength>]" << std::endl;
+}
+
+// Read a scene description file, return false if the file cannot be parsed
+static bool loadScene(const std::string& path, std::vector<Shape>& shapes)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::SCENE:: Cannot open " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream stream(line);
+        std::string type;
+        if (!(stream >> type))
+        {
+            continue;
+        }
+
+        if (type != "sphere")
+        {
+            std::cout << "ERROR::SCENE:: " << path << ":" << lineNumber << " unknown shape '" << type << "'" << std::endl;
+            return false;
+        }
+
+        glm::vec3 position, color;
+        float radius;
+        if (!(stream >> position.x >> position.y >> position.z >> radius >> color.r >> color.g >> color.b))
+        {
+            std::cout << "ERROR::SCENE:: " << path << ":" << lineNumber << " expected 'sphere x y z radius r g b'" << std::endl;
+            return false;
+        }
+
+        Shape shape(position, glm::vec3(radius), color, "Sphere " + std::to_string(shapes.size()));
+
+        std::string operation;
+        if (stream >> operation)
+        {
+            if (operation == "blend")
+            {
+                shape.operation = EOperation::BLEND;
+                stream >> shape.blendStrength;
+            }
+            else if (operation != "default")
+            {
+                std::cout << "ERROR::SCENE:: " << path << ":" << lineNumber << " unknown operation '" << operation << "'" << std::endl;
+                return false;
+            }
+        }
+
+        shapes.push_back(shape);
+    }
+
+    return true;
+}
+
+// Binary PPM, rows written top to bottom (the buffer starts with the bottom row)
+static bool writePPM(const std::string& path, const std::vector<unsigned char>& buffer, int width, int height)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::OUTPUT:: Cannot open " << path << std::endl;
+        return false;
+    }
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (int y = height - 1; y >= 0; --y)
+    {
+        file.write((const char*)&buffer[(size_t)y * width * 3], (std::streamsize)width * 3);
+    }
+
+    return (bool)file;
+}
+
+int main(int argc, char** argv)
+{
+    int width = 600;
+    int height = 400;
+    std::string scenePath;
+    std::string outputPath = "out.ppm";
+    glm::vec3 eye = { 0, 0, -4 };
+    glm::vec3 center = { 0, 0, 0 };
+    float epsilon = -1.0f;
+    float maxDistance = -1.0f;
+    bool usePGA = true;
+    int threads = 0;
+    int samples = 0;
+    bool adaptiveSampling = true;
+    bool usePackets = true;
+    bool useBVH = true;
+    bool coneMarching = true;
+    bool analyticSpheres = true;
+    bool tileBinning = true;
+    float relaxation = 1.0f;
+    ENormalMode normalMode = ENormalMode::ANALYTIC;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto hasValues = [&](int count) { return i + count < argc; };
+
+        if (!std::strcmp(argv[i], "--width") && hasValues(1))
+            width = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--height") && hasValues(1))
+            height = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--scene") && hasValues(1))
+            scenePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--output") && hasValues(1))
+            outputPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--epsilon") && hasValues(1))
+            epsilon = (float)std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--max-distance") && hasValues(1))
+            maxDistance = (float)std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--samples") && hasValues(1))
+            samples = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--no-adaptive"))
+            adaptiveSampling = false;
+        else if (!std::strcmp(argv[i], "--threads") && hasValues(1))
+            threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--no-pga"))
+            usePGA = false;
+        else if (!std::strcmp(argv[i], "--no-packets"))
+            usePackets = false;
+        else if (!std::strcmp(argv[i], "--no-bvh"))
+            useBVH = false;
+        else if (!std::strcmp(argv[i], "--no-cones"))
+            coneMarching = false;
+        else if (!std::strcmp(argv[i], "--no-analytic"))
+            analyticSpheres = false;
+        else if (!std::strcmp(argv[i], "--no-binning"))
+            tileBinning = false;
+        else if (!std::strcmp(argv[i], "--relaxation") && hasValues(1))
+            relaxation = (float)std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--normals") && hasValues(1))
+        {
+            std::string mode = argv[++i];
+            if (mode == "central")
+                normalMode = ENormalMode::CENTRAL_DIFFERENCES;
+            else if (mode == "tetrahedron")
+                normalMode = ENormalMode::TETRAHEDRON;
+            else if (mode == "analytic")
+                normalMode = ENormalMode::ANALYTIC;
+            else
+            {
+                std::cout << "ERROR::ARGS:: Unknown normal mode '" << mode << "'" << std::endl;
+                return -1;
+            }
+        }
+        else if (!std::strcmp(argv[i], "--eye") && hasValues(3))
+        {
+            eye.x = (float)std::atof(argv[++i]);
+            eye.y = (float)std::atof(argv[++i]);
+            eye.z = (float)std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--center") && hasValues(3))
+        {
+            center.x = (float)std::atof(argv[++i]);
+            center.y = (float)std::atof(argv[++i]);
+            center.z = (float)std::atof(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return !std::strcmp(argv[i], "--help") ? 0 : -1;
+        }
+    }
+
+    if (width <= 0 || height <= 0)
+    {
+        std::cout << "ERROR::ARGS:: Invalid image size " << width << "x" << height << std::endl;
+        return -1;
+    }
+
+    RayMarchingManager rayMarching(width, height, threads);
+
+    if (!scenePath.empty())
+    {
+        std::vector<Shape> shapes;
+        if (!loadScene(scenePath, shapes))
+        {
+            return -1;
+        }
+        rayMarching.setShapes(shapes);
+    }
+
+    if (samples > 0)
+        rayMarching.setMaxSamples(samples);
+    if (epsilon > 0.0f)
+        rayMarching.getEpsilon() = epsilon;
+    if (maxDistance > 0.0f)
+        rayMarching.getMaxDistance() = maxDistance;
+    rayMarching.getUsePGA() = usePGA;
+    rayMarching.getUsePackets() = usePackets;
+    rayMarching.getUseBVH() = useBVH;
+    rayMarching.getConeMarching() = coneMarching;
+    rayMarching.getAnalyticSpheres() = analyticSpheres;
+    rayMarching.getTileBinning() = tileBinning;
+    rayMarching.getAdaptiveSampling() = adaptiveSampling;
+    if (relaxation > 1.0f)
+    {
+        rayMarching.getOverRelaxation() = true;
+        rayMarching.getRelaxationFactor() = relaxation;
+    }
+    rayMarching.getNormalMode() = normalMode;
+
+    Camera& camera = rayMarching.getCamera();
+    camera._eye = eye;
+    camera._center = center;
+    camera.updateCamera();
+    rayMarching.UpdateView();
+
+    long long rays = 0;
+    long long marchSteps = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (rayMarching.getCurrentSample() < rayMarching.getMaxSamples())
+    {
+        rayMarching.update();
+        rays += rayMarching.getStats().rays;
+        marchSteps += rayMarching.getStats().marchSteps;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << "Rendered " << width << "x" << height << " x " << rayMarching.getMaxSamples() << " samples in "
+        << std::chrono::duration<double, std::milli>(end - start).count() << " ms, "
+        << rays << " rays, " << marchSteps << " march steps" << std::endl;
+
+    if (!writePPM(outputPath, rayMarching.getBuffer(), width, height))
+    {
+        return -1;
+    }
+
+    std::cout << "Saved " << outputPath << std::endl;
+    return 0;
+}
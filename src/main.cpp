@@ -7,6 +7,7 @@
 #include "Editor.hpp"
 #include "Framebuffer.hpp"
 #include "RayMarching.hpp"
+#include "RenderThread.hpp"
 
 int main(void)
 {
@@ -38,6 +39,11 @@ int main(void)
     int viewer3DWidth = 600;
     int viewer3DHeight = 400;
     RayMarchingManager rayMarching(viewer3DWidth, viewer3DHeight);
+    Framebuffer fbo(viewer3DWidth, viewer3DHeight, rayMarching.getBuffer());
+
+    // Samples are rendered on their own thread, the loop below presents the newest one
+    // and stays at display rate whatever a frame costs
+    RenderThread renderThread(rayMarching);
 
     // Initialize ImGui
     initEditor(window);
@@ -49,9 +55,13 @@ int main(void)
         glClearColor(0.1, 0.15f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        rayMarching.update();
+        renderThread.presentFrame(fbo);
 
-        drawEditor(rayMarching);
+        {
+            auto lock = renderThread.lock();
+            drawEditor(rayMarching, fbo);
+        }
+        renderThread.notify();
         renderEditor();
 
         /* Swap front and back buffers */
@@ -61,7 +71,7 @@ int main(void)
         glfwPollEvents();
     }
 
-    rayMarching.free();
+    fbo.free();
     glfwTerminate();
     return 0;
 }
\ No newline at end of file
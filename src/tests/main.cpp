@@ -0,0 +1,358 @@
+// Regression tests of the renderer, one ctest case each: RayMarchingTests <name>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "RayMarching.hpp"
+
+
+static const int WIDTH = 200;
+static const int HEIGHT = 150;
+
+// Unions and blends of overlapping spheres, lit interiors and silhouettes against the background
+static std::vector<Shape> makeScene()
+{
+    std::vector<Shape> shapes;
+    for (int i = 0; i < 12; ++i)
+    {
+        const float angle = i * 0.52f;
+        const glm::vec3 position(std::cos(angle) * (0.4f + 0.08f * i), std::sin(angle) * 0.7f, 0.1f * (i % 4));
+        Shape shape(position, glm::vec3(0.25f + 0.03f * (i % 5)), { 255, (unsigned char)(60 + 15 * i), 40 }, "Sphere " + std::to_string(i));
+        if (i % 3 == 1)
+        {
+            shape.operation = EOperation::BLEND;
+        }
+        shapes.push_back(shape);
+    }
+    return shapes;
+}
+
+// At least BVH_MIN_SHAPES spheres on a grid, unions and weak blends, each query of the BVH keeps a few of them.
+// With a cluster of blended spheres, the queries around it keep more than BVH_MAX_CANDIDATES shapes and fold
+// every shape instead (too few to leave the BVH out of the scene)
+static std::vector<Shape> makeLargeScene(bool cluster)
+{
+    std::vector<Shape> shapes;
+    const int side = 8;
+    for (int i = 0; i < side * side * side; ++i)
+    {
+        const glm::vec3 position = glm::vec3(i % side, (i / side) % side, i / (side * side)) * (4.0f / side) - glm::vec3(2.0f);
+        Shape shape(position, glm::vec3(0.1f), { 200, (unsigned char)(i % 256), 80 }, "Sphere " + std::to_string(i));
+        if (i % 4 == 1)
+        {
+            shape.operation = EOperation::BLEND;
+            shape.blendStrength = 0.05f;
+        }
+        shapes.push_back(shape);
+    }
+
+    for (int i = 0; i < 64 && cluster; ++i)
+    {
+        const float angle = i * 0.7f;
+        const glm::vec3 position(0.3f * std::cos(angle), 0.3f * std::sin(angle * 1.3f), -0.8f + 0.01f * i);
+        Shape shape(position, glm::vec3(0.08f), { 60, 120, (unsigned char)(4 * i) }, "Cluster " + std::to_string(i));
+        shape.operation = EOperation::BLEND;
+        shape.blendStrength = 0.1f;
+        shapes.push_back(shape);
+    }
+    return shapes;
+}
+
+// Render until the image is final
+static std::vector<unsigned char> render(RayMarchingManager& rayMarching)
+{
+    while (rayMarching.needsUpdate())
+    {
+        rayMarching.update();
+    }
+    return rayMarching.getBuffer();
+}
+
+// Pixels with a channel more than tolerance levels away from the reference
+static int countDifferences(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference, int tolerance)
+{
+    int count = 0;
+    for (size_t i = 0; i < image.size(); i += 3)
+    {
+        bool differs = false;
+        for (int c = 0; c < 3; ++c)
+        {
+            differs |= std::abs(image[i + c] - reference[i + c]) > tolerance;
+        }
+        count += differs;
+    }
+    return count;
+}
+
+static bool expectSimilar(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference, int tolerance, int maxPixels)
+{
+    const int differences = countDifferences(image, reference, tolerance);
+    if (differences > maxPixels)
+    {
+        std::cout << "ERROR::TEST:: " << differences << " pixels more than " << tolerance << " levels off the reference, "
+            << maxPixels << " allowed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// A checkerboard frame marches half of the first sample: with a single sample, the image must still be
+// marched everywhere, not reconstructed
+static bool testCheckerboardSingleSample()
+{
+    RayMarchingManager reference(WIDTH, HEIGHT);
+    reference.setShapes(makeScene());
+    reference.setMaxSamples(1);
+
+    RayMarchingManager checkerboard(WIDTH, HEIGHT);
+    checkerboard.setShapes(makeScene());
+    checkerboard.setMaxSamples(1);
+    checkerboard.getCheckerboard() = true;
+
+    return expectSimilar(render(checkerboard), render(reference), 0, 0);
+}
+
+// A shape moved between the two checkerboard halves of the first sample of a new view: the first sample
+// covers the whole view, the image must match a full render of the new view and scene
+static bool testCheckerboardMoveShape()
+{
+    std::vector<Shape> moved = makeScene();
+    moved[0].position.x += 0.2f;
+    moved[0].center = { moved[0].position.x, moved[0].position.y, moved[0].position.z };
+
+    RayMarchingManager checkerboard(WIDTH, HEIGHT);
+    checkerboard.setShapes(makeScene());
+    checkerboard.setMaxSamples(1);
+    checkerboard.getCheckerboard() = true;
+    render(checkerboard);
+
+    checkerboard.getCamera()._eye.x += 0.1f;
+    checkerboard.getCamera().updateCamera();
+    checkerboard.UpdateView();
+    checkerboard.update();
+    checkerboard.getShapeAtIndex(0) = moved[0];
+    checkerboard.UpdateShape(0);
+
+    RayMarchingManager reference(WIDTH, HEIGHT);
+    reference.setShapes(moved);
+    reference.setMaxSamples(1);
+    reference.getCamera() = checkerboard.getCamera();
+    reference.UpdateView();
+
+    return expectSimilar(render(checkerboard), render(reference), 0, 0);
+}
+
+// Cone marching starts the rays closer to the surfaces, where they stop anywhere within epsilon of it: the
+// hits move along the ray, and so do their normals and shading. Against the rays marched from the camera
+// with the analytic normals, at most 1.5% of the pixels differ by more than 8 levels (lit interiors, up to
+// 32 levels) and 0.2% by more than 32 (silhouettes)
+static bool testConeMarchingTolerance()
+{
+    RayMarchingManager reference(WIDTH, HEIGHT);
+    reference.setShapes(makeScene());
+    reference.setMaxSamples(1);
+    reference.getAnalyticSpheres() = false;
+    reference.getConeMarching() = false;
+    reference.getUsePackets() = false;
+
+    RayMarchingManager cones(WIDTH, HEIGHT);
+    cones.setShapes(makeScene());
+    cones.setMaxSamples(1);
+    cones.getAnalyticSpheres() = false;
+
+    const std::vector<unsigned char> image = render(cones);
+    const std::vector<unsigned char> expected = render(reference);
+    return expectSimilar(image, expected, 8, WIDTH * HEIGHT * 15 / 1000) && expectSimilar(image, expected, 32, WIDTH * HEIGHT * 2 / 1000);
+}
+
+// Adaptive sampling marches fewer and fewer pixels of a still view, frames far below the budget must not
+// rescale (and restart) the image: it reaches maxSamples
+static bool testDynamicResolutionConverges()
+{
+    RayMarchingManager rayMarching(WIDTH, HEIGHT);
+    rayMarching.setShapes(makeScene());
+    rayMarching.setMaxSamples(20);
+
+    // Budget of a frame at half the resolution on this machine
+    const auto start = std::chrono::steady_clock::now();
+    rayMarching.update();
+    const float frameMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    rayMarching.getDynamicResolution() = true;
+    rayMarching.getFrameBudget() = frameMs / 4.0f;
+    rayMarching.UpdateScene();
+
+    const int maxUpdates = 200;
+    int updates = 0;
+    for (; updates < maxUpdates && rayMarching.needsUpdate(); ++updates)
+    {
+        rayMarching.update();
+    }
+
+    if (rayMarching.needsUpdate())
+    {
+        std::cout << "ERROR::TEST:: Sample " << rayMarching.getCurrentSample() << " of " << rayMarching.getMaxSamples()
+            << " after " << maxUpdates << " updates, render scale " << rayMarching.getRenderWidth() << "x" << rayMarching.getRenderHeight() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Lowering the noise threshold keeps the samples, the pixels no longer converged take the samples they
+// miss in the same order as a render with that threshold from the start
+static bool testAdaptiveThresholdChange()
+{
+    RayMarchingManager reference(WIDTH, HEIGHT);
+    reference.setShapes(makeScene());
+    reference.getAdaptiveThreshold() = 0.5f;
+
+    RayMarchingManager changed(WIDTH, HEIGHT);
+    changed.setShapes(makeScene());
+    changed.getAdaptiveThreshold() = 4.0f;
+    render(changed);
+    changed.getAdaptiveThreshold() = 0.5f;
+    changed.UpdateSampling();
+
+    return expectSimilar(render(changed), render(reference), 0, 0);
+}
+
+// The BVH skips the shapes that cannot change the fold, exactly: the image is the one of the linear fold,
+// packets and cones included. Without the BVH, tile binning is not exact (see binning_tolerance)
+static bool renderWithAndWithoutBVH(bool cluster)
+{
+    RayMarchingManager linear(WIDTH, HEIGHT);
+    linear.setShapes(makeLargeScene(cluster));
+    linear.setMaxSamples(1);
+    linear.getUseBVH() = false;
+    linear.getTileBinning() = false;
+
+    RayMarchingManager bvh(WIDTH, HEIGHT);
+    bvh.setShapes(makeLargeScene(cluster));
+    bvh.setMaxSamples(1);
+
+    return expectSimilar(render(bvh), render(linear), 0, 0);
+}
+
+static bool testBVHMatchesLinear()
+{
+    return renderWithAndWithoutBVH(false);
+}
+
+static bool testBVHOverflowMatchesLinear()
+{
+    return renderWithAndWithoutBVH(true);
+}
+
+// Tile binning folds only the shapes whose bounds project onto the tile. Far from its shapes the folded
+// distance is larger, the steps land elsewhere and the rays stop at other points within epsilon of the
+// surfaces, as with the cones: at most 1.5% of the pixels differ by more than 8 levels and 0.2% by more
+// than 32. A sphere across the plane of the camera projects to the whole image, it is binned into every tile
+static bool renderWithAndWithoutBinning(bool unionOnly)
+{
+    std::vector<Shape> shapes = makeScene();
+    for (Shape& shape : shapes)
+    {
+        shape.operation = unionOnly ? EOperation::DEFAULT : shape.operation;
+    }
+    shapes.push_back(Shape({ 0.9f, 0.0f, -3.6f }, glm::vec3(0.8f), { 40, 200, 90 }, "Camera Plane"));
+
+    RayMarchingManager all(WIDTH, HEIGHT);
+    all.setShapes(shapes);
+    all.setMaxSamples(1);
+    all.getTileBinning() = false;
+    all.getAnalyticSpheres() = false;
+
+    RayMarchingManager binned(WIDTH, HEIGHT);
+    binned.setShapes(shapes);
+    binned.setMaxSamples(1);
+    binned.getAnalyticSpheres() = false;
+
+    const std::vector<unsigned char> image = render(binned);
+    const std::vector<unsigned char> expected = render(all);
+    return expectSimilar(image, expected, 8, WIDTH * HEIGHT * 15 / 1000) && expectSimilar(image, expected, 32, WIDTH * HEIGHT * 2 / 1000);
+}
+
+static bool testBinningTolerance()
+{
+    return renderWithAndWithoutBinning(false) && renderWithAndWithoutBinning(true);
+}
+
+// Analytic tracing hits the spheres grown by epsilon where the marched rays stop anywhere within epsilon of
+// them, as with the cones: at most 1.5% of the pixels differ by more than 8 levels and 0.2% by more than 32.
+// From inside a sphere, both shade the first step of the ray and the images are the same
+static bool renderWithAndWithoutAnalytic(bool insideSphere)
+{
+    std::vector<Shape> shapes = makeScene();
+    for (Shape& shape : shapes)
+    {
+        shape.operation = EOperation::DEFAULT;
+    }
+    if (insideSphere)
+    {
+        shapes.push_back(Shape({ 0.1f, 0.05f, -3.8f }, glm::vec3(0.5f), { 40, 200, 90 }, "Around the camera"));
+    }
+
+    RayMarchingManager marched(WIDTH, HEIGHT);
+    marched.setShapes(shapes);
+    marched.setMaxSamples(1);
+    marched.getAnalyticSpheres() = false;
+
+    RayMarchingManager analytic(WIDTH, HEIGHT);
+    analytic.setShapes(shapes);
+    analytic.setMaxSamples(1);
+
+    const std::vector<unsigned char> image = render(analytic);
+    const std::vector<unsigned char> expected = render(marched);
+    if (insideSphere)
+    {
+        return expectSimilar(image, expected, 0, 0);
+    }
+    return expectSimilar(image, expected, 8, WIDTH * HEIGHT * 15 / 1000) && expectSimilar(image, expected, 32, WIDTH * HEIGHT * 2 / 1000);
+}
+
+static bool testAnalyticMatchesMarching()
+{
+    return renderWithAndWithoutAnalytic(false) && renderWithAndWithoutAnalytic(true);
+}
+
+struct Test
+{
+    const char* name;
+    bool (*run)();
+};
+
+static const Test tests[] = {
+    { "checkerboard_single_sample", testCheckerboardSingleSample },
+    { "checkerboard_move_shape", testCheckerboardMoveShape },
+    { "cone_marching_tolerance", testConeMarchingTolerance },
+    { "dynamic_resolution_converges", testDynamicResolutionConverges },
+    { "adaptive_threshold_change", testAdaptiveThresholdChange },
+    { "bvh_matches_linear", testBVHMatchesLinear },
+    { "bvh_overflow_matches_linear", testBVHOverflowMatchesLinear },
+    { "binning_tolerance", testBinningTolerance },
+    { "analytic_matches_marching", testAnalyticMatchesMarching },
+};
+
+int main(int argc, char** argv)
+{
+    if (argc == 2)
+    {
+        for (const Test& test : tests)
+        {
+            if (!std::strcmp(argv[1], test.name))
+            {
+                return test.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+        }
+    }
+
+    std::cout << "Usage: " << argv[0] << " <test>" << std::endl;
+    for (const Test& test : tests)
+    {
+        std::cout << "  " << test.name << std::endl;
+    }
+    return EXIT_FAILURE;
+}